@@ -0,0 +1,346 @@
+/*!
+ * @file racon_benchmark.cpp
+ *
+ * @brief Racon microbenchmark source file
+ */
+
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sequence.hpp"
+#include "overlap.hpp"
+#include "window.hpp"
+#include "source.hpp"
+#include "banded_alignment_engine.hpp"
+#include "kernels.hpp"
+#include "simulator.hpp"
+
+#include "spoa/spoa.hpp"
+
+static const uint32_t kSeed = 42;
+
+static struct option options[] = {
+    {"repetitions", required_argument, 0, 'r'},
+    {"filter", required_argument, 0, 'f'},
+    {"help", no_argument, 0, 'h'},
+    {0, 0, 0, 0}
+};
+
+void help();
+
+/*!
+ * @brief Creates overlaps of whole sequences through the public span
+ * interface (as an embedding program would)
+ */
+std::vector<std::unique_ptr<racon::Overlap>> createOverlaps(
+    const std::vector<std::pair<std::string, std::string>>& names,
+    uint32_t q_length, uint32_t t_length) {
+
+    std::vector<racon::OverlapSpan> spans;
+    for (const auto& it: names) {
+        spans.push_back({it.first.c_str(), static_cast<uint32_t>(it.first.size()),
+            q_length, 0, q_length, '+', it.second.c_str(),
+            static_cast<uint32_t>(it.second.size()), t_length, 0, t_length, 0, 0,
+            255});
+    }
+
+    std::vector<std::unique_ptr<racon::Overlap>> dst;
+    racon::createSource(spans.data(), spans.size())->parse(dst, -1);
+    return dst;
+}
+
+/*!
+ * @brief Runs setup and kernel the given number of times and prints the
+ * minimal and median time of the kernel (setup is not measured)
+ */
+void measure(const std::string& name, uint32_t repetitions,
+    const std::string& filter, const std::function<void()>& setup,
+    const std::function<void()>& kernel) {
+
+    if (!filter.empty() && name.find(filter) == std::string::npos) {
+        return;
+    }
+
+    std::vector<double> times;
+    for (uint32_t i = 0; i < repetitions; ++i) {
+        setup();
+        auto begin = std::chrono::steady_clock::now();
+        kernel();
+        auto end = std::chrono::steady_clock::now();
+        times.emplace_back(std::chrono::duration_cast<std::chrono::duration<double,
+            std::micro>>(end - begin).count());
+    }
+    std::sort(times.begin(), times.end());
+
+    fprintf(stdout, "%s\t%u\t%.3f\t%.3f\n", name.c_str(), repetitions,
+        times.front(), times[times.size() / 2]);
+    fflush(stdout);
+}
+
+int main(int argc, char** argv) {
+
+    uint32_t repetitions = 10;
+    std::string filter = "";
+
+    int32_t argument;
+    while ((argument = getopt_long(argc, argv, "r:f:h", options, nullptr)) != -1) {
+        switch (argument) {
+            case 'r':
+                repetitions = atoi(optarg);
+                break;
+            case 'f':
+                filter = optarg;
+                break;
+            case 'h':
+                help();
+                exit(0);
+            default:
+                exit(1);
+        }
+    }
+
+    if (repetitions == 0) {
+        fprintf(stderr, "[racon_benchmark::] error: invalid number of repetitions!\n");
+        exit(1);
+    }
+
+    fprintf(stderr, "[racon_benchmark::] using %s kernels\n",
+        racon::selectKernels().name);
+    fprintf(stdout, "benchmark\trepetitions\tmin_us\tmedian_us\n");
+
+    // Window::generate_consensus
+    for (uint32_t window_length: {500, 1000, 2000}) {
+        for (uint32_t depth: {10, 30, 60}) {
+            std::mt19937 generator(kSeed);
+            auto reference = racon::createRandomSequence(window_length, generator);
+            auto backbone = racon::createNoisySequence(reference, 0.1, generator);
+            std::string backbone_quality(backbone.size(), '!');
+            std::vector<std::string> layers;
+            for (uint32_t i = 0; i < depth; ++i) {
+                layers.emplace_back(racon::createNoisySequence(reference, 0.1,
+                    generator));
+            }
+
+            std::shared_ptr<spoa::AlignmentEngine> alignment_engine =
+                spoa::createAlignmentEngine(spoa::AlignmentType::kNW, 3, -5, -4);
+            alignment_engine->prealloc(window_length, 5);
+
+            std::shared_ptr<racon::BandedAlignmentEngine> banded_alignment_engine =
+                racon::createBandedAlignmentEngine(3, -5, -4);
+            banded_alignment_engine->set_band_width(64);
+
+            for (bool is_banded: {false, true}) {
+                std::shared_ptr<racon::Window> window;
+                measure(std::string(is_banded ? "generate_consensus_banded/" :
+                    "generate_consensus/") + std::to_string(window_length) + "/" +
+                    std::to_string(depth), repetitions, filter,
+                    [&]() -> void {
+                        window = racon::createWindow(0, 0, racon::WindowType::kTGS,
+                            backbone.c_str(), backbone.size(), backbone_quality.c_str(),
+                            backbone_quality.size());
+                        for (const auto& it: layers) {
+                            window->add_layer(it.c_str(), it.size(), nullptr, 0, 0,
+                                backbone.size() - 1);
+                        }
+                    },
+                    [&]() -> void {
+                        window->generate_consensus(alignment_engine, true,
+                            is_banded ? banded_alignment_engine : nullptr);
+                    });
+            }
+        }
+    }
+
+    // BandedAlignmentEngine::align compared to spoa::AlignmentEngine::align
+    // of one layer to a graph of the backbone and the given number of layers
+    for (uint32_t window_length: {500, 1000, 2000}) {
+        for (uint32_t depth: {10, 30, 60}) {
+            std::mt19937 generator(kSeed);
+            auto reference = racon::createRandomSequence(window_length, generator);
+            auto backbone = racon::createNoisySequence(reference, 0.1, generator);
+            auto layer = racon::createNoisySequence(reference, 0.1, generator);
+
+            std::shared_ptr<spoa::AlignmentEngine> alignment_engine =
+                spoa::createAlignmentEngine(spoa::AlignmentType::kNW, 3, -5, -4);
+            alignment_engine->prealloc(window_length, 5);
+
+            auto banded_alignment_engine = racon::createBandedAlignmentEngine(3,
+                -5, -4);
+            banded_alignment_engine->set_band_width(64);
+
+            auto graph = spoa::createGraph();
+            graph->add_alignment(spoa::Alignment(), backbone);
+            for (uint32_t i = 0; i < depth; ++i) {
+                auto sequence = racon::createNoisySequence(reference, 0.1,
+                    generator);
+                graph->add_alignment(alignment_engine->align(sequence, graph),
+                    sequence);
+            }
+
+            std::vector<int32_t> mapping;
+            spoa::Alignment alignment;
+            measure("align_spoa/" + std::to_string(window_length) + "/" +
+                std::to_string(depth), repetitions, filter,
+                []() -> void {},
+                [&]() -> void {
+                    alignment = alignment_engine->align(layer, graph);
+                });
+            measure("align_banded/" + std::to_string(window_length) + "/" +
+                std::to_string(depth), repetitions, filter,
+                []() -> void {},
+                [&]() -> void {
+                    banded_alignment_engine->align(layer.c_str(), layer.size(),
+                        graph, 0, backbone.size() - 1, mapping, alignment);
+                });
+        }
+    }
+
+    // Window::generate_pileup_consensus on accurate layers without indels,
+    // compared to Window::generate_consensus on the same input
+    for (uint32_t window_length: {500, 1000, 2000}) {
+        for (uint32_t depth: {10, 30, 60}) {
+            std::mt19937 generator(kSeed);
+            auto reference = racon::createRandomSequence(window_length, generator);
+            auto backbone = racon::createMutatedSequence(reference, 0.01, generator);
+            std::string backbone_quality(backbone.size(), '!');
+            std::vector<std::string> layers;
+            for (uint32_t i = 0; i < depth; ++i) {
+                layers.emplace_back(racon::createMutatedSequence(reference, 0.005,
+                    generator));
+            }
+
+            std::shared_ptr<spoa::AlignmentEngine> alignment_engine =
+                spoa::createAlignmentEngine(spoa::AlignmentType::kNW, 3, -5, -4);
+            alignment_engine->prealloc(window_length, 5);
+
+            for (bool is_pileup: {false, true}) {
+                std::shared_ptr<racon::Window> window;
+                measure(std::string(is_pileup ? "generate_consensus_pileup/" :
+                    "generate_consensus_accurate/") + std::to_string(window_length) +
+                    "/" + std::to_string(depth), repetitions, filter,
+                    [&]() -> void {
+                        window = racon::createWindow(0, 0, racon::WindowType::kNGS,
+                            backbone.c_str(), backbone.size(), backbone_quality.c_str(),
+                            backbone_quality.size());
+                        for (const auto& it: layers) {
+                            window->add_layer(it.c_str(), it.size(), nullptr, 0, 0,
+                                backbone.size() - 1);
+                        }
+                    },
+                    [&]() -> void {
+                        if (!is_pileup || !window->generate_pileup_consensus(true)) {
+                            window->generate_consensus(alignment_engine, true);
+                        }
+                    });
+            }
+        }
+    }
+
+    // Overlap::align and Overlap::find_breaking_points (the latter includes
+    // the alignment, the difference of both is the cost of breaking points)
+    for (uint32_t length: {1000, 10000, 50000}) {
+        std::mt19937 generator(kSeed);
+        auto t = racon::createRandomSequence(length, generator);
+        auto q = racon::createNoisySequence(t, 0.1, generator);
+
+        std::vector<std::unique_ptr<racon::Sequence>> sequences;
+        sequences.emplace_back(racon::createSequence("q", q));
+        sequences.emplace_back(racon::createSequence("t", t));
+        std::unordered_map<std::string, uint64_t> name_to_id = {{"qq", 0}, {"tt", 1}};
+        std::unordered_map<uint64_t, uint64_t> id_to_id;
+
+        std::vector<std::unique_ptr<racon::Overlap>> overlaps;
+        auto setup = [&]() -> void {
+            overlaps = createOverlaps({{"q", "t"}}, q.size(), t.size());
+            overlaps.front()->transmute(sequences, name_to_id, id_to_id);
+        };
+
+        measure("align/" + std::to_string(length), repetitions, filter, setup,
+            [&]() -> void {
+                overlaps.front()->align(sequences);
+            });
+
+        measure("find_breaking_points/" + std::to_string(length), repetitions,
+            filter, setup,
+            [&]() -> void {
+                overlaps.front()->find_breaking_points(sequences, 500);
+            });
+    }
+
+    // Sequence::create_reverse_complement
+    for (uint32_t length: {100000, 10000000}) {
+        std::mt19937 generator(kSeed);
+        auto data = racon::createRandomSequence(length, generator);
+
+        std::unique_ptr<racon::Sequence> sequence;
+        measure("create_reverse_complement/" + std::to_string(length),
+            repetitions, filter,
+            [&]() -> void {
+                sequence = racon::createSequence("s", data);
+            },
+            [&]() -> void {
+                sequence->create_reverse_complement();
+            });
+    }
+
+    // name_to_id resolution of Overlap::transmute
+    for (uint32_t num_sequences: {10000, 100000}) {
+        std::vector<std::unique_ptr<racon::Sequence>> sequences;
+        std::unordered_map<std::string, uint64_t> name_to_id;
+        std::unordered_map<uint64_t, uint64_t> id_to_id;
+        for (uint32_t i = 0; i < num_sequences; ++i) {
+            auto name = "read_" + std::to_string(i);
+            name_to_id[name + "q"] = i;
+            name_to_id[name + "t"] = i;
+            sequences.emplace_back(racon::createSequence(name, std::string(100, 'A')));
+        }
+
+        std::mt19937 generator(kSeed);
+        std::uniform_int_distribution<uint32_t> id(0, num_sequences - 1);
+        std::vector<std::pair<std::string, std::string>> pairs;
+        for (uint32_t i = 0; i < num_sequences; ++i) {
+            pairs.emplace_back(sequences[id(generator)]->name(),
+                sequences[id(generator)]->name());
+        }
+
+        std::vector<std::unique_ptr<racon::Overlap>> overlaps;
+        measure("name_to_id/" + std::to_string(num_sequences), repetitions,
+            filter,
+            [&]() -> void {
+                overlaps = createOverlaps(pairs, 100, 100);
+            },
+            [&]() -> void {
+                for (const auto& it: overlaps) {
+                    it->transmute(sequences, name_to_id, id_to_id);
+                }
+            });
+    }
+
+    return 0;
+}
+
+void help() {
+    printf(
+        "usage: racon_benchmark [options ...]\n"
+        "\n"
+        "    runs microbenchmarks of racon kernels on synthetic data with fixed\n"
+        "    seeds and prints tab separated minimal and median times\n"
+        "\n"
+        "    options:\n"
+        "        -r, --repetitions <int>\n"
+        "            default: 10\n"
+        "            number of measurements per benchmark\n"
+        "        -f, --filter <string>\n"
+        "            runs only benchmarks whose name contains the string\n"
+        "        -h, --help\n"
+        "            prints the usage\n");
+}
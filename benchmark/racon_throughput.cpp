@@ -0,0 +1,412 @@
+/*!
+ * @file racon_throughput.cpp
+ *
+ * @brief Racon end-to-end throughput benchmark source file
+ */
+
+#include <errno.h>
+#include <getopt.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "sequence.hpp"
+#include "polisher.hpp"
+#include "simulator.hpp"
+
+static struct option options[] = {
+    {"genome-size", required_argument, 0, 'g'},
+    {"contig-length", required_argument, 0, 'c'},
+    {"depth", required_argument, 0, 'd'},
+    {"read-length", required_argument, 0, 'l'},
+    {"error-rate", required_argument, 0, 'e'},
+    {"draft-error-rate", required_argument, 0, 'D'},
+    {"sam", no_argument, 0, 's'},
+    {"seed", required_argument, 0, 'S'},
+    {"window-length", required_argument, 0, 'w'},
+    {"threads", required_argument, 0, 't'},
+    {"output", required_argument, 0, 'o'},
+    {"help", no_argument, 0, 'h'},
+    {0, 0, 0, 0}
+};
+
+void help();
+
+struct Parameters {
+    uint64_t genome_size;
+    uint32_t contig_length;
+    uint32_t depth;
+    uint32_t read_length;
+    double error_rate;
+    double draft_error_rate;
+    bool is_sam;
+    uint32_t seed;
+};
+
+/*!
+ * @brief Writes a draft assembly with substitutions, reads sampled from both
+ * strands of the error free reference and overlaps of reads to the draft
+ * (PAF or SAM with exact CIGAR strings), one contig at a time
+ */
+void simulate(const Parameters& parameters, const std::string& draft_path,
+    const std::string& reads_path, const std::string& overlaps_path) {
+
+    FILE* draft_file = fopen(draft_path.c_str(), "w");
+    FILE* reads_file = fopen(reads_path.c_str(), "w");
+    FILE* overlaps_file = fopen(overlaps_path.c_str(), "w");
+    if (draft_file == nullptr || reads_file == nullptr || overlaps_file == nullptr) {
+        fprintf(stderr, "[racon_throughput::simulate] error: "
+            "unable to create data files!\n");
+        exit(1);
+    }
+
+    std::vector<uint32_t> contig_lengths;
+    for (uint64_t i = 0; i < parameters.genome_size; i += parameters.contig_length) {
+        contig_lengths.emplace_back(std::min<uint64_t>(parameters.contig_length,
+            parameters.genome_size - i));
+    }
+
+    if (parameters.is_sam) {
+        fprintf(overlaps_file, "@HD\tVN:1.6\tSO:unsorted\n");
+        for (uint32_t i = 0; i < contig_lengths.size(); ++i) {
+            fprintf(overlaps_file, "@SQ\tSN:contig_%u\tLN:%u\n", i, contig_lengths[i]);
+        }
+    }
+
+    std::mt19937 generator(parameters.seed);
+    uint64_t num_reads = 0;
+
+    for (uint32_t i = 0; i < contig_lengths.size(); ++i) {
+        auto reference = racon::createRandomSequence(contig_lengths[i], generator);
+        auto draft = racon::createMutatedSequence(reference,
+            parameters.draft_error_rate, generator);
+        fprintf(draft_file, ">contig_%u\n%s\n", i, draft.c_str());
+        std::string().swap(draft);
+
+        uint32_t read_length = std::min(parameters.read_length, contig_lengths[i]);
+        uint64_t contig_num_reads = static_cast<uint64_t>(contig_lengths[i]) *
+            parameters.depth / read_length;
+        std::uniform_int_distribution<uint32_t> begin(0, contig_lengths[i] - read_length);
+        std::uniform_int_distribution<uint32_t> strand(0, 1);
+
+        std::string cigar;
+        for (uint64_t j = 0; j < contig_num_reads; ++j, ++num_reads) {
+            uint32_t t_begin = begin(generator);
+            auto data = racon::createNoisySequence(reference.substr(t_begin,
+                read_length), parameters.error_rate, generator, &cigar);
+            if (data.empty()) {
+                continue;
+            }
+            bool is_reverse = strand(generator);
+            std::string quality(data.size(), '5');
+
+            if (parameters.is_sam) {
+                fprintf(overlaps_file, "read_%lu\t%u\tcontig_%u\t%u\t60\t%s\t*\t0\t0\t%s\t%s\n",
+                    static_cast<unsigned long>(num_reads), is_reverse ? 16 : 0, i,
+                    t_begin + 1, cigar.c_str(), data.c_str(), quality.c_str());
+            } else {
+                uint32_t overlap_length = std::max<uint32_t>(data.size(), read_length);
+                fprintf(overlaps_file, "read_%lu\t%zu\t0\t%zu\t%c\tcontig_%u\t%u\t%u\t%u\t%u\t%u\t255\n",
+                    static_cast<unsigned long>(num_reads), data.size(), data.size(),
+                    is_reverse ? '-' : '+', i, contig_lengths[i], t_begin,
+                    t_begin + read_length, static_cast<uint32_t>(overlap_length *
+                    (1 - parameters.error_rate)), overlap_length);
+            }
+
+            if (is_reverse) {
+                data = racon::createReverseComplement(data);
+            }
+            fprintf(reads_file, "@read_%lu\n%s\n+\n%s\n",
+                static_cast<unsigned long>(num_reads), data.c_str(), quality.c_str());
+        }
+    }
+
+    fclose(overlaps_file);
+    fclose(reads_file);
+    fclose(draft_file);
+}
+
+struct Run {
+    uint32_t num_threads;
+    double wall_time;
+    double cpu_time;
+    uint64_t peak_rss;
+    uint64_t num_bases;
+};
+
+/*!
+ * @brief Polishes the draft in a child process so that its peak memory and
+ * CPU time are measured in isolation
+ */
+Run polish(const std::string& draft_path, const std::string& reads_path,
+    const std::string& overlaps_path, uint32_t window_length,
+    uint32_t num_threads) {
+
+    int32_t pipe_fds[2];
+    if (pipe(pipe_fds) != 0) {
+        fprintf(stderr, "[racon_throughput::polish] error: unable to create pipe!\n");
+        exit(1);
+    }
+
+    pid_t pid = fork();
+    if (pid < 0) {
+        fprintf(stderr, "[racon_throughput::polish] error: unable to fork!\n");
+        exit(1);
+    }
+
+    if (pid == 0) {
+        close(pipe_fds[0]);
+
+        auto begin = std::chrono::steady_clock::now();
+
+        auto polisher = racon::createPolisher(reads_path, overlaps_path,
+            draft_path, racon::PolisherType::kC, window_length, 10, 0.3, true,
+            3, -5, -4, num_threads);
+
+        uint64_t num_bases = 0;
+        polisher->run([&](std::unique_ptr<racon::Sequence> sequence) -> void {
+            num_bases += sequence->data().size();
+        }, false);
+
+        double wall_time = std::chrono::duration_cast<std::chrono::duration<double>>(
+            std::chrono::steady_clock::now() - begin).count();
+
+        std::string result = std::to_string(wall_time) + " " + std::to_string(num_bases);
+        if (write(pipe_fds[1], result.c_str(), result.size()) !=
+            static_cast<ssize_t>(result.size())) {
+            _exit(1);
+        }
+        close(pipe_fds[1]);
+        _exit(0);
+    }
+
+    close(pipe_fds[1]);
+    std::string result;
+    char buffer[256];
+    ssize_t n;
+    while ((n = read(pipe_fds[0], buffer, sizeof(buffer))) > 0) {
+        result.append(buffer, n);
+    }
+    close(pipe_fds[0]);
+
+    int32_t status = 0;
+    struct rusage usage;
+    if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status) ||
+        WEXITSTATUS(status) != 0) {
+        fprintf(stderr, "[racon_throughput::polish] error: "
+            "polishing with %u threads failed!\n", num_threads);
+        exit(1);
+    }
+
+    Run run = {num_threads, 0, 0, 0, 0};
+    unsigned long num_bases = 0;
+    if (sscanf(result.c_str(), "%lf %lu", &run.wall_time, &num_bases) != 2) {
+        fprintf(stderr, "[racon_throughput::polish] error: "
+            "missing result of polishing with %u threads!\n", num_threads);
+        exit(1);
+    }
+    run.num_bases = num_bases;
+    run.cpu_time = usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+        (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+    run.peak_rss = static_cast<uint64_t>(usage.ru_maxrss) * 1024; // kB on Linux
+
+    return run;
+}
+
+int main(int argc, char** argv) {
+
+    Parameters parameters = {1000000, 1000000, 30, 10000, 0.1, 0.01, false, 42};
+    uint32_t window_length = 500;
+    std::vector<uint32_t> threads = {1};
+    std::string output_directory = "";
+
+    std::string optstring = "g:c:d:l:e:D:sS:w:t:o:h";
+
+    int32_t argument;
+    while ((argument = getopt_long(argc, argv, optstring.c_str(), options, nullptr)) != -1) {
+        switch (argument) {
+            case 'g':
+                parameters.genome_size = atoll(optarg);
+                break;
+            case 'c':
+                parameters.contig_length = atoi(optarg);
+                break;
+            case 'd':
+                parameters.depth = atoi(optarg);
+                break;
+            case 'l':
+                parameters.read_length = atoi(optarg);
+                break;
+            case 'e':
+                parameters.error_rate = atof(optarg);
+                break;
+            case 'D':
+                parameters.draft_error_rate = atof(optarg);
+                break;
+            case 's':
+                parameters.is_sam = true;
+                break;
+            case 'S':
+                parameters.seed = atoi(optarg);
+                break;
+            case 'w':
+                window_length = atoi(optarg);
+                break;
+            case 't':
+                threads.clear();
+                for (char* it = strtok(optarg, ","); it != nullptr; it = strtok(nullptr, ",")) {
+                    threads.emplace_back(atoi(it));
+                }
+                break;
+            case 'o':
+                output_directory = optarg;
+                break;
+            case 'h':
+                help();
+                exit(0);
+            default:
+                exit(1);
+        }
+    }
+
+    if (parameters.genome_size == 0 || parameters.contig_length == 0 ||
+        parameters.depth == 0 || parameters.read_length == 0 ||
+        window_length == 0 || threads.empty() ||
+        std::find(threads.begin(), threads.end(), 0) != threads.end()) {
+        fprintf(stderr, "[racon_throughput::] error: invalid parameters!\n");
+        exit(1);
+    }
+
+    // generated data is removed at the end unless a directory is given
+    bool is_temporary = output_directory.empty();
+    if (is_temporary) {
+        char directory[] = "/tmp/racon_throughput_XXXXXX";
+        if (mkdtemp(directory) == nullptr) {
+            fprintf(stderr, "[racon_throughput::] error: "
+                "unable to create temporary directory!\n");
+            exit(1);
+        }
+        output_directory = directory;
+    } else if (mkdir(output_directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "[racon_throughput::] error: "
+            "unable to create directory %s!\n", output_directory.c_str());
+        exit(1);
+    }
+
+    std::string draft_path = output_directory + "/draft.fasta";
+    std::string reads_path = output_directory + "/reads.fastq";
+    std::string overlaps_path = output_directory + (parameters.is_sam ?
+        "/overlaps.sam" : "/overlaps.paf");
+
+    auto begin = std::chrono::steady_clock::now();
+    simulate(parameters, draft_path, reads_path, overlaps_path);
+    double simulation_time = std::chrono::duration_cast<std::chrono::duration<double>>(
+        std::chrono::steady_clock::now() - begin).count();
+    fprintf(stderr, "[racon_throughput::] simulated data in %s (%.3f s)\n",
+        output_directory.c_str(), simulation_time);
+
+    std::vector<Run> runs;
+    for (const auto& it: threads) {
+        runs.emplace_back(polish(draft_path, reads_path, overlaps_path,
+            window_length, it));
+        fprintf(stderr, "[racon_throughput::] polished with %u threads (%.3f s)\n",
+            it, runs.back().wall_time);
+    }
+
+    if (is_temporary) {
+        remove(draft_path.c_str());
+        remove(reads_path.c_str());
+        remove(overlaps_path.c_str());
+        rmdir(output_directory.c_str());
+    }
+
+    // speedup is relative to the first run
+    fprintf(stdout, "{\n"
+        "  \"genome_size\": %lu,\n"
+        "  \"contig_length\": %u,\n"
+        "  \"depth\": %u,\n"
+        "  \"read_length\": %u,\n"
+        "  \"error_rate\": %g,\n"
+        "  \"draft_error_rate\": %g,\n"
+        "  \"overlaps\": \"%s\",\n"
+        "  \"seed\": %u,\n"
+        "  \"window_length\": %u,\n"
+        "  \"runs\": [",
+        static_cast<unsigned long>(parameters.genome_size), parameters.contig_length,
+        parameters.depth, parameters.read_length, parameters.error_rate,
+        parameters.draft_error_rate, parameters.is_sam ? "sam" : "paf",
+        parameters.seed, window_length);
+    for (uint32_t i = 0; i < runs.size(); ++i) {
+        const auto& it = runs[i];
+        fprintf(stdout, "%s\n    {\"threads\": %u, \"wall_time\": %.3f, "
+            "\"cpu_time\": %.3f, \"peak_rss\": %lu, \"polished_bases\": %lu, "
+            "\"bases_per_second\": %.1f, \"thread_efficiency\": %.3f, "
+            "\"speedup\": %.3f}", i == 0 ? "" : ",", it.num_threads, it.wall_time,
+            it.cpu_time, static_cast<unsigned long>(it.peak_rss),
+            static_cast<unsigned long>(it.num_bases),
+            parameters.genome_size / it.wall_time,
+            it.cpu_time / (it.wall_time * it.num_threads),
+            runs.front().wall_time / it.wall_time);
+    }
+    fprintf(stdout, "\n  ]\n}\n");
+
+    return 0;
+}
+
+void help() {
+    printf(
+        "usage: racon_throughput [options ...]\n"
+        "\n"
+        "    simulates a draft assembly, reads and their overlaps to the draft,\n"
+        "    polishes the draft with racon once per given number of threads and\n"
+        "    prints bases per second, CPU time, peak memory and thread\n"
+        "    efficiency (CPU time / (wall time * threads)) in JSON format\n"
+        "\n"
+        "    options:\n"
+        "        -g, --genome-size <int>\n"
+        "            default: 1000000\n"
+        "            total length of the reference\n"
+        "        -c, --contig-length <int>\n"
+        "            default: 1000000\n"
+        "            maximal length of contigs the reference is split into\n"
+        "        -d, --depth <int>\n"
+        "            default: 30\n"
+        "            sequencing depth\n"
+        "        -l, --read-length <int>\n"
+        "            default: 10000\n"
+        "            length of reads on the reference (e.g. 150 for short reads)\n"
+        "        -e, --error-rate <float>\n"
+        "            default: 0.1\n"
+        "            rate of substitutions, insertions and deletions in reads\n"
+        "        -D, --draft-error-rate <float>\n"
+        "            default: 0.01\n"
+        "            rate of substitutions in the draft assembly\n"
+        "        -s, --sam\n"
+        "            writes overlaps in SAM format with CIGAR strings instead of\n"
+        "            PAF (alignment of overlaps is skipped)\n"
+        "        -S, --seed <int>\n"
+        "            default: 42\n"
+        "            seed of the random number generator\n"
+        "        -w, --window-length <int>\n"
+        "            default: 500\n"
+        "            size of window on which POA is performed\n"
+        "        -t, --threads <int>[,<int>...]\n"
+        "            default: 1\n"
+        "            comma separated numbers of threads, racon is run once for each\n"
+        "        -o, --output <directory>\n"
+        "            keeps simulated data in the given directory (default is a\n"
+        "            temporary directory which is removed at the end)\n"
+        "        -h, --help\n"
+        "            prints the usage\n");
+}
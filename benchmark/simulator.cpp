@@ -0,0 +1,110 @@
+/*!
+ * @file simulator.cpp
+ *
+ * @brief Synthetic data generator source file
+ */
+
+#include "simulator.hpp"
+
+namespace racon {
+
+static const char kBases[] = "ACGT";
+
+std::string createRandomSequence(uint32_t length, std::mt19937& generator) {
+
+    std::uniform_int_distribution<uint32_t> base(0, 3);
+
+    std::string dst(length, 'A');
+    for (auto& it: dst) {
+        it = kBases[base(generator)];
+    }
+    return dst;
+}
+
+std::string createNoisySequence(const std::string& src, double error_rate,
+    std::mt19937& generator, std::string* cigar) {
+
+    std::uniform_real_distribution<double> error(0., 1.);
+    std::uniform_int_distribution<uint32_t> type(0, 2), base(0, 3);
+
+    // operations are run-length encoded on the fly
+    char operation = 0;
+    uint32_t num_operations = 0;
+    auto add_operation = [&](char value) -> void {
+        if (cigar == nullptr) {
+            return;
+        }
+        if (value != operation && num_operations != 0) {
+            *cigar += std::to_string(num_operations) + operation;
+            num_operations = 0;
+        }
+        operation = value;
+        ++num_operations;
+    };
+    if (cigar != nullptr) {
+        cigar->clear();
+    }
+
+    std::string dst;
+    dst.reserve(src.size() * 1.1);
+    for (const auto& it: src) {
+        if (error(generator) >= error_rate) {
+            dst += it;
+            add_operation('M');
+            continue;
+        }
+        switch (type(generator)) {
+            case 0:
+                dst += kBases[base(generator)];
+                add_operation('M');
+                break;
+            case 1:
+                dst += it;
+                add_operation('M');
+                dst += kBases[base(generator)];
+                add_operation('I');
+                break;
+            default:
+                add_operation('D');
+                break;
+        }
+    }
+    if (cigar != nullptr && num_operations != 0) {
+        *cigar += std::to_string(num_operations) + operation;
+    }
+
+    return dst;
+}
+
+std::string createMutatedSequence(const std::string& src, double error_rate,
+    std::mt19937& generator) {
+
+    std::uniform_real_distribution<double> error(0., 1.);
+    std::uniform_int_distribution<uint32_t> base(1, 3);
+
+    std::string dst(src);
+    for (auto& it: dst) {
+        if (error(generator) < error_rate) {
+            // always a different base
+            it = kBases[(std::string(kBases).find(it) + base(generator)) % 4];
+        }
+    }
+    return dst;
+}
+
+std::string createReverseComplement(const std::string& src) {
+
+    std::string dst(src.rbegin(), src.rend());
+    for (auto& it: dst) {
+        switch (it) {
+            case 'A': it = 'T'; break;
+            case 'T': it = 'A'; break;
+            case 'C': it = 'G'; break;
+            case 'G': it = 'C'; break;
+            default: break;
+        }
+    }
+    return dst;
+}
+
+}
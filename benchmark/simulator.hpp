@@ -0,0 +1,33 @@
+/*!
+ * @file simulator.hpp
+ *
+ * @brief Synthetic data generator header file
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <random>
+#include <string>
+
+namespace racon {
+
+std::string createRandomSequence(uint32_t length, std::mt19937& generator);
+
+/*!
+ * @brief Copies src with substitutions, insertions and deletions which are
+ * equally likely; if cigar is given, it is set to the alignment of the copy
+ * to src (substitutions are matches)
+ */
+std::string createNoisySequence(const std::string& src, double error_rate,
+    std::mt19937& generator, std::string* cigar = nullptr);
+
+/*!
+ * @brief Copies src with substitutions only (positions stay the same)
+ */
+std::string createMutatedSequence(const std::string& src, double error_rate,
+    std::mt19937& generator);
+
+std::string createReverseComplement(const std::string& src);
+
+}
@@ -0,0 +1,75 @@
+#!/usr/bin/env python
+
+from __future__ import print_function
+import sys, gzip, heapq, argparse
+
+def eprint(*args, **kwargs):
+    print(*args, file=sys.stderr, **kwargs)
+
+#*******************************************************************************
+
+def open_file(file_name):
+    if (file_name.endswith('.gz')):
+        return gzip.open(file_name, 'rt')
+    return open(file_name)
+
+def parse_file(file_name):
+    name = None
+    data = []
+    with (open_file(file_name)) as f:
+        for line in f:
+            line = line.rstrip()
+            if (len(line) == 0):
+                continue
+            if (line[0] == '>'):
+                if (name is not None):
+                    yield parse_target_index(name, file_name) + (''.join(data),)
+                name = line[1:]
+                data = []
+            elif (name is None):
+                eprint('[racon_merge::] error: file {} is not in FASTA format!'.format(file_name))
+                sys.exit(1)
+            else:
+                data.append(line)
+    if (name is not None):
+        yield parse_target_index(name, file_name) + (''.join(data),)
+
+def parse_target_index(name, file_name):
+    tags = name.split(' ')
+    for i, tag in enumerate(tags):
+        if (tag.startswith('TI:i:')):
+            return (int(tag[5:]), ' '.join(tags[:i] + tags[i + 1:]))
+    eprint('[racon_merge::] error: sequence {} in file {} has no TI tag!'.format(
+        tags[0], file_name))
+    sys.exit(1)
+
+#*******************************************************************************
+
+if __name__ == '__main__':
+
+    parser = argparse.ArgumentParser(description='''Merges outputs of racon runs
+        with option --shard into a single FASTA file (written to stdout) which
+        preserves the order of target sequences.''',
+        formatter_class=argparse.ArgumentDefaultsHelpFormatter)
+    parser.add_argument('shards', nargs='+', help='''output files of all shards
+        in FASTA format (can be compressed with gzip)''')
+    parser.add_argument('--allow-gaps', action='store_true', help='''do not
+        fail on missing target indices, which are expected only if shards were
+        run without option -u (unpolished sequences are dropped)''')
+
+    args = parser.parse_args()
+
+    # target indices of all shards together are contiguous unless a shard
+    # file is missing or truncated
+    last_index = -1
+    for index, name, data in heapq.merge(*[parse_file(it) for it in args.shards]):
+        if (index == last_index):
+            eprint('[racon_merge::] error: duplicate target index {}!'.format(index))
+            sys.exit(1)
+        if (index != last_index + 1 and not args.allow_gaps):
+            eprint('[racon_merge::] error: missing target index {} (missing or '
+                'truncated shard, or use --allow-gaps)!'.format(last_index + 1))
+            sys.exit(1)
+        last_index = index
+        print('>' + name)
+        print(data)
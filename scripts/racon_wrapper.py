@@ -19,13 +19,13 @@ class RaconWrapper:
         cudaaligner_batches, cudapoa_batches, cuda_banded_alignment):
 
         self.sequences = os.path.abspath(sequences)
-        self.subsampled_sequences = None
         self.overlaps = os.path.abspath(overlaps)
         self.target_sequences = os.path.abspath(target_sequences)
         self.split_target_sequences = []
         self.chunk_size = split
-        self.reference_length, self.coverage = subsample if subsample is not None\
-            else (None, None)
+        # subsampling is done by racon which keeps the best overlaps of each
+        # window, the reference length is no longer needed
+        self.coverage = subsample[1] if subsample is not None else None
         self.include_unpolished = include_unpolished
         self.fragment_correction = fragment_correction
         self.window_length = window_length
@@ -56,33 +56,8 @@ class RaconWrapper:
 
     def run(self):
         # run preprocess
-        eprint('[RaconWrapper::run] preparing data with rampler')
-        if (self.reference_length is not None and self.coverage is not None):
-            try:
-                p = subprocess.Popen([RaconWrapper.__rampler, '-o', self.work_directory,
-                    'subsample', self.sequences, self.reference_length, self.coverage])
-            except OSError:
-                eprint('[RaconWrapper::run] error: unable to run rampler!')
-                sys.exit(1)
-            p.communicate()
-            if (p.returncode != 0):
-                sys.exit(1)
-
-            base_name = os.path.basename(self.sequences).split('.')[0]
-            extension = '.fasta' if (self.sequences.endswith('.fasta') or\
-                self.sequences.endswith('.fasta.gz') or\
-                self.sequences.endswith('.fa') or\
-                self.sequences.endswith('.fa.gz')) else\
-                '.fastq'
-            self.subsampled_sequences = os.path.join(self.work_directory, base_name) +\
-                '_' + self.coverage + 'x' + extension
-            if (not os.path.isfile(self.subsampled_sequences)):
-                eprint('[RaconWrapper::run] error: unable to find subsampled sequences!')
-                sys.exit(1)
-        else:
-            self.subsampled_sequences = self.sequences
-
         if (self.chunk_size is not None):
+            eprint('[RaconWrapper::run] preparing data with rampler')
             try:
                 p = subprocess.Popen([RaconWrapper.__rampler, '-o', self.work_directory,
                     'split', self.target_sequences, self.chunk_size])
@@ -126,10 +101,13 @@ class RaconWrapper:
             '-m', str(self.match),
             '-x', str(self.mismatch),
             '-g', str(self.gap),
-            '-t', str(self.threads),
+            '-t', str(self.threads)])
+        if (self.coverage is not None):
+            racon_params.extend(['--max-coverage', str(self.coverage)])
+        racon_params.extend([
             # '--cudaaligner-batches', str(self.cudaaligner_batches),
             # '-c', str(self.cudapoa_batches),
-            self.subsampled_sequences, self.overlaps, ""])
+            self.sequences, self.overlaps, ""])
 
         for target_sequences_part in self.split_target_sequences:
             eprint('[RaconWrapper::run] processing data with racon')
@@ -143,7 +121,6 @@ class RaconWrapper:
             if (p.returncode != 0):
                 sys.exit(1)
 
-        self.subsampled_sequences = None
         self.split_target_sequences = []
 
 #*******************************************************************************
@@ -169,7 +146,8 @@ if __name__ == '__main__':
     parser.add_argument('--split', help='''split target sequences into chunks of
         desired size in bytes''')
     parser.add_argument('--subsample', nargs=2, help='''subsample sequences to
-        desired coverage (2nd argument) given the reference length (1st argument)''')
+        desired coverage (2nd argument) by aligning only the best overlaps of
+        each window (see --max-coverage of racon, 1st argument is ignored)''')
     parser.add_argument('-u', '--include-unpolished', action='store_true',
         help='''output unpolished target sequences''')
     parser.add_argument('-f', '--fragment-correction', action='store_true',
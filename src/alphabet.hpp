@@ -0,0 +1,35 @@
+/*!
+ * @file alphabet.hpp
+ *
+ * @brief Base encoding shared by racon aligners header file
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace racon {
+
+// A, C, G and T are encoded as 0 to 3, all other bases share kUnknownCode
+constexpr uint8_t kNumBases = 4;
+constexpr uint8_t kUnknownCode = 4;
+
+inline uint8_t encodeBase(char base) {
+    switch (base) {
+        case 'A': return 0;
+        case 'C': return 1;
+        case 'G': return 2;
+        case 'T': return 3;
+        default: return kUnknownCode;
+    }
+}
+
+inline char decodeBase(uint8_t code) {
+    return "ACGTN"[code];
+}
+
+inline uint8_t complementCode(uint8_t code) {
+    return code < kNumBases ? kNumBases - 1 - code : code;
+}
+
+}
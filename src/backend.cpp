@@ -0,0 +1,302 @@
+/*!
+ * @file backend.cpp
+ *
+ * @brief Backend classes and registry source file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <map>
+#include <mutex>
+
+#include "window.hpp"
+#include "overlap.hpp"
+#include "sequence.hpp"
+#include "banded_alignment_engine.hpp"
+#include "cpubatch.hpp"
+#include "cpualigner.hpp"
+#include "backend.hpp"
+
+#include "spoa/spoa.hpp"
+
+namespace racon {
+
+Backend::Backend()
+        : name_(), throughput_({0, 0, 0}) {
+}
+
+BackendThroughput Backend::take_throughput() {
+    BackendThroughput dst = throughput_;
+    throughput_ = {0, 0, 0};
+    return dst;
+}
+
+void Backend::record(uint64_t num_items, uint64_t num_bases,
+    std::chrono::steady_clock::time_point begin) {
+
+    throughput_.num_items += num_items;
+    throughput_.num_bases += num_bases;
+    throughput_.num_nanoseconds += std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - begin).count();
+}
+
+void ConsensusBackend::generate_consensus(
+    const std::vector<std::shared_ptr<Window>>& windows, std::vector<bool>& dst) {
+
+    auto begin = std::chrono::steady_clock::now();
+    dst.assign(windows.size(), false);
+    run(windows, dst);
+
+    uint64_t num_bases = 0;
+    for (const auto& it: windows) {
+        num_bases += it->num_bases();
+    }
+    record(windows.size(), num_bases, begin);
+}
+
+void AlignerBackend::align(const std::vector<Overlap*>& overlaps,
+    std::vector<std::unique_ptr<Sequence>>& sequences) {
+
+    auto begin = std::chrono::steady_clock::now();
+    run(overlaps, sequences);
+
+    uint64_t num_bases = 0;
+    for (const auto& it: overlaps) {
+        num_bases += it->length();
+    }
+    record(overlaps.size(), num_bases, begin);
+}
+
+// spoa, optionally preceded by the banded engine
+class SpoaConsensusBackend: public ConsensusBackend {
+public:
+    SpoaConsensusBackend(const BackendParameters& parameters, bool is_banded)
+            : trim_(parameters.trim), alignment_engine_(spoa::createAlignmentEngine(
+            spoa::AlignmentType::kNW, parameters.match, parameters.mismatch,
+            parameters.gap)), banded_alignment_engine_(nullptr) {
+
+        alignment_engine_->prealloc(parameters.window_length, 5);
+        if (is_banded) {
+            banded_alignment_engine_ = createBandedAlignmentEngine(
+                parameters.match, parameters.mismatch, parameters.gap);
+            banded_alignment_engine_->set_band_width(parameters.band_width);
+        }
+    }
+
+private:
+    void run(const std::vector<std::shared_ptr<Window>>& windows,
+        std::vector<bool>& dst) override {
+
+        for (uint32_t i = 0; i < windows.size(); ++i) {
+            dst[i] = windows[i]->generate_consensus(alignment_engine_, trim_,
+                banded_alignment_engine_);
+        }
+    }
+
+    bool trim_;
+    std::shared_ptr<spoa::AlignmentEngine> alignment_engine_;
+    std::shared_ptr<BandedAlignmentEngine> banded_alignment_engine_;
+};
+
+// weighted vote over gapless pileups, windows with indels are left to spoa
+// as a whole (even if a single column has them)
+class PileupConsensusBackend: public ConsensusBackend {
+public:
+    explicit PileupConsensusBackend(const BackendParameters& parameters)
+            : trim_(parameters.trim), alignment_engine_(spoa::createAlignmentEngine(
+            spoa::AlignmentType::kNW, parameters.match, parameters.mismatch,
+            parameters.gap)) {
+
+        alignment_engine_->prealloc(parameters.window_length, 5);
+    }
+
+private:
+    void run(const std::vector<std::shared_ptr<Window>>& windows,
+        std::vector<bool>& dst) override {
+
+        for (uint32_t i = 0; i < windows.size(); ++i) {
+            dst[i] = windows[i]->generate_pileup_consensus(trim_) ||
+                windows[i]->generate_consensus(alignment_engine_, trim_);
+        }
+    }
+
+    bool trim_;
+    std::shared_ptr<spoa::AlignmentEngine> alignment_engine_;
+};
+
+class BatchConsensusBackend: public ConsensusBackend {
+public:
+    explicit BatchConsensusBackend(const BackendParameters& parameters)
+            : batch_(createCPUBatch(parameters.match, parameters.mismatch,
+            parameters.gap, parameters.trim)) {
+    }
+
+    uint32_t batch_size() const override {
+        return batch_->max_windows();
+    }
+
+private:
+    void run(const std::vector<std::shared_ptr<Window>>& windows,
+        std::vector<bool>& dst) override {
+
+        for (uint32_t i = 0, j = 0; i < windows.size(); i = j) {
+            batch_->reset();
+            while (j < windows.size() && batch_->addWindow(windows[j])) {
+                ++j;
+            }
+            const auto& batch_status = batch_->generateConsensus();
+            for (uint32_t k = i; k < j; ++k) {
+                dst[k] = batch_status[k - i];
+            }
+        }
+        batch_->reset();
+    }
+
+    std::unique_ptr<CPUBatchProcessor> batch_;
+};
+
+class EdlibAlignerBackend: public AlignerBackend {
+private:
+    void run(const std::vector<Overlap*>& overlaps,
+        std::vector<std::unique_ptr<Sequence>>& sequences) override {
+
+        for (const auto& it: overlaps) {
+            it->align(sequences);
+        }
+    }
+};
+
+class BatchAlignerBackend: public AlignerBackend {
+public:
+    explicit BatchAlignerBackend(const BackendParameters& parameters)
+            : aligner_(createCPUBatchAligner(parameters.error_threshold)) {
+    }
+
+    uint32_t batch_size() const override {
+        return aligner_->max_overlaps();
+    }
+
+    bool uses_codes() const override {
+        return true;
+    }
+
+private:
+    void run(const std::vector<Overlap*>& overlaps,
+        std::vector<std::unique_ptr<Sequence>>& sequences) override {
+
+        // overlaps which do not fit into the workspace start a new batch
+        for (uint32_t i = 0; i < overlaps.size();) {
+            aligner_->reset();
+            while (i < overlaps.size() && aligner_->addOverlap(overlaps[i], sequences)) {
+                ++i;
+            }
+            aligner_->alignAll();
+        }
+        aligner_->reset();
+    }
+
+    std::unique_ptr<CPUBatchAligner> aligner_;
+};
+
+static std::mutex registry_mutex;
+
+static std::map<std::string, ConsensusBackendFactory>& consensusBackends() {
+    static std::map<std::string, ConsensusBackendFactory> factories = {
+        {"spoa", [](const BackendParameters& parameters) -> std::unique_ptr<ConsensusBackend> {
+            return std::unique_ptr<ConsensusBackend>(new SpoaConsensusBackend(
+                parameters, false));
+        }},
+        {"banded", [](const BackendParameters& parameters) -> std::unique_ptr<ConsensusBackend> {
+            return std::unique_ptr<ConsensusBackend>(new SpoaConsensusBackend(
+                parameters, true));
+        }},
+        {"batch", [](const BackendParameters& parameters) -> std::unique_ptr<ConsensusBackend> {
+            return std::unique_ptr<ConsensusBackend>(new BatchConsensusBackend(
+                parameters));
+        }},
+        {"pileup", [](const BackendParameters& parameters) -> std::unique_ptr<ConsensusBackend> {
+            return std::unique_ptr<ConsensusBackend>(new PileupConsensusBackend(
+                parameters));
+        }}
+    };
+    return factories;
+}
+
+static std::map<std::string, AlignerBackendFactory>& alignerBackends() {
+    static std::map<std::string, AlignerBackendFactory> factories = {
+        {"edlib", [](const BackendParameters&) -> std::unique_ptr<AlignerBackend> {
+            return std::unique_ptr<AlignerBackend>(new EdlibAlignerBackend());
+        }},
+        {"batch", [](const BackendParameters& parameters) -> std::unique_ptr<AlignerBackend> {
+            return std::unique_ptr<AlignerBackend>(new BatchAlignerBackend(
+                parameters));
+        }}
+    };
+    return factories;
+}
+
+void registerConsensusBackend(const std::string& name,
+    ConsensusBackendFactory factory) {
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    consensusBackends()[name] = factory;
+}
+
+void registerAlignerBackend(const std::string& name,
+    AlignerBackendFactory factory) {
+
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    alignerBackends()[name] = factory;
+}
+
+bool hasConsensusBackend(const std::string& name) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    return consensusBackends().count(name) != 0;
+}
+
+bool hasAlignerBackend(const std::string& name) {
+    std::lock_guard<std::mutex> lock(registry_mutex);
+    return alignerBackends().count(name) != 0;
+}
+
+std::unique_ptr<ConsensusBackend> createConsensusBackend(const std::string& name,
+    const BackendParameters& parameters) {
+
+    ConsensusBackendFactory factory;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto it = consensusBackends().find(name);
+        if (it == consensusBackends().end()) {
+            fprintf(stderr, "[racon::createConsensusBackend] error: "
+                "unknown backend %s!\n", name.c_str());
+            exit(1);
+        }
+        factory = it->second;
+    }
+
+    auto dst = factory(parameters);
+    dst->name_ = name;
+    return dst;
+}
+
+std::unique_ptr<AlignerBackend> createAlignerBackend(const std::string& name,
+    const BackendParameters& parameters) {
+
+    AlignerBackendFactory factory;
+    {
+        std::lock_guard<std::mutex> lock(registry_mutex);
+        auto it = alignerBackends().find(name);
+        if (it == alignerBackends().end()) {
+            fprintf(stderr, "[racon::createAlignerBackend] error: "
+                "unknown backend %s!\n", name.c_str());
+            exit(1);
+        }
+        factory = it->second;
+    }
+
+    auto dst = factory(parameters);
+    dst->name_ = name;
+    return dst;
+}
+
+}
@@ -0,0 +1,160 @@
+/*!
+ * @file backend.hpp
+ *
+ * @brief Backend classes and registry header file
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace racon {
+
+class Window;
+class Overlap;
+class Sequence;
+
+struct BackendParameters;
+
+class ConsensusBackend;
+std::unique_ptr<ConsensusBackend> createConsensusBackend(const std::string& name,
+    const BackendParameters& parameters);
+
+class AlignerBackend;
+std::unique_ptr<AlignerBackend> createAlignerBackend(const std::string& name,
+    const BackendParameters& parameters);
+
+/*!
+ * @brief Parameters with which every backend is created
+ */
+struct BackendParameters {
+    int8_t match;
+    int8_t mismatch;
+    int8_t gap;
+    bool trim;
+    uint32_t window_length;
+    uint32_t band_width;
+    double error_threshold;
+};
+
+/*!
+ * @brief Work done by a backend, bases are those of all inputs (backbones and
+ * layers of windows, overlap lengths) and time is summed over calls
+ */
+struct BackendThroughput {
+    uint64_t num_items;
+    uint64_t num_bases;
+    uint64_t num_nanoseconds;
+};
+
+class Backend {
+public:
+    virtual ~Backend() = default;
+
+    // name under which the backend is registered
+    const std::string& name() const {
+        return name_;
+    }
+
+    /*!
+     * @brief Returns the throughput accumulated since the last call
+     */
+    BackendThroughput take_throughput();
+
+    /*!
+     * @brief Maximal number of items passed to the backend at once
+     */
+    virtual uint32_t batch_size() const {
+        return 1;
+    }
+
+    friend std::unique_ptr<ConsensusBackend> createConsensusBackend(
+        const std::string& name, const BackendParameters& parameters);
+    friend std::unique_ptr<AlignerBackend> createAlignerBackend(
+        const std::string& name, const BackendParameters& parameters);
+protected:
+    Backend();
+    Backend(const Backend&) = delete;
+    const Backend& operator=(const Backend&) = delete;
+
+    void record(uint64_t num_items, uint64_t num_bases,
+        std::chrono::steady_clock::time_point begin);
+
+private:
+    std::string name_;
+    BackendThroughput throughput_;
+};
+
+/*!
+ * @brief Generates consensus of windows
+ */
+class ConsensusBackend: public Backend {
+public:
+    /*!
+     * @brief Generates consensus of at most batch_size() windows and stores
+     * whether each of them was polished in dst
+     */
+    void generate_consensus(const std::vector<std::shared_ptr<Window>>& windows,
+        std::vector<bool>& dst);
+
+protected:
+    ConsensusBackend() = default;
+
+private:
+    virtual void run(const std::vector<std::shared_ptr<Window>>& windows,
+        std::vector<bool>& dst) = 0;
+};
+
+/*!
+ * @brief Aligns overlaps and stores their cigar strings, overlaps left without
+ * one are aligned with edlib by Overlap::find_breaking_points
+ */
+class AlignerBackend: public Backend {
+public:
+    /*!
+     * @brief Aligns at most batch_size() overlaps
+     */
+    void align(const std::vector<Overlap*>& overlaps,
+        std::vector<std::unique_ptr<Sequence>>& sequences);
+
+    /*!
+     * @brief Whether the backend aligns sequences encoded at load time (see
+     * Sequence::encode) instead of their bases
+     */
+    virtual bool uses_codes() const {
+        return false;
+    }
+
+protected:
+    AlignerBackend() = default;
+
+private:
+    virtual void run(const std::vector<Overlap*>& overlaps,
+        std::vector<std::unique_ptr<Sequence>>& sequences) = 0;
+};
+
+using ConsensusBackendFactory = std::function<std::unique_ptr<ConsensusBackend>(
+    const BackendParameters&)>;
+using AlignerBackendFactory = std::function<std::unique_ptr<AlignerBackend>(
+    const BackendParameters&)>;
+
+/*!
+ * @brief Registers a factory under the given name (replacing the previous
+ * one), backends have to be registered before polishing starts; built-in
+ * consensus backends are spoa, banded, batch and pileup, aligner backends
+ * edlib and batch
+ */
+void registerConsensusBackend(const std::string& name,
+    ConsensusBackendFactory factory);
+void registerAlignerBackend(const std::string& name,
+    AlignerBackendFactory factory);
+
+bool hasConsensusBackend(const std::string& name);
+bool hasAlignerBackend(const std::string& name);
+
+}
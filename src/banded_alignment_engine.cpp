@@ -0,0 +1,207 @@
+/*!
+ * @file banded_alignment_engine.cpp
+ *
+ * @brief BandedAlignmentEngine class source file
+ */
+
+#include <algorithm>
+#include <limits>
+
+#include "kernels.hpp"
+#include "banded_alignment_engine.hpp"
+
+#include "spoa/spoa.hpp"
+
+namespace racon {
+
+constexpr int32_t kNegativeInfinity = std::numeric_limits<int32_t>::min() / 2;
+
+std::unique_ptr<BandedAlignmentEngine> createBandedAlignmentEngine(int8_t match,
+    int8_t mismatch, int8_t gap) {
+
+    return std::unique_ptr<BandedAlignmentEngine>(new BandedAlignmentEngine(
+        match, mismatch, gap));
+}
+
+BandedAlignmentEngine::BandedAlignmentEngine(int8_t match, int8_t mismatch,
+    int8_t gap)
+        : match_(match), mismatch_(mismatch), gap_(gap), band_width_(0),
+        node_id_to_rank_(), positions_(), band_begins_(), band_ends_(), offsets_(),
+        matrix_(), predecessors_(), profile_(), kernels_(selectKernels()) {
+}
+
+int32_t BandedAlignmentEngine::score(uint32_t row, uint32_t column) const {
+    if (column < band_begins_[row] || column > band_ends_[row]) {
+        return kNegativeInfinity;
+    }
+    return matrix_[offsets_[row] + column - band_begins_[row]];
+}
+
+bool BandedAlignmentEngine::align(const char* sequence, uint32_t sequence_length,
+    const std::unique_ptr<spoa::Graph>& graph, uint32_t begin, uint32_t end,
+    const std::vector<int32_t>& mapping,
+    std::vector<std::pair<int32_t, int32_t>>& dst) {
+
+    dst.clear();
+
+    const auto& nodes = graph->nodes();
+    const auto& rank_to_node_id = graph->rank_to_node_id();
+    uint32_t num_rows = rank_to_node_id.size() + 1;
+    uint32_t num_columns = sequence_length + 1;
+
+    if (band_width_ == 0 || sequence_length == 0 || num_rows == 1 ||
+        begin > end || 2 * band_width_ + 1 >= sequence_length) {
+        return false;
+    }
+
+    node_id_to_rank_.resize(nodes.size());
+    for (uint32_t i = 0; i < rank_to_node_id.size(); ++i) {
+        node_id_to_rank_[rank_to_node_id[i]] = i;
+    }
+
+    // predecessors and positions on the backbone, whose nodes were created
+    // first (i.e. their ids are their positions), other nodes are placed one
+    // position after their furthest predecessor
+    predecessors_.resize(num_rows);
+    positions_.resize(num_rows);
+    positions_[0] = static_cast<int64_t>(begin) - 1;
+    for (uint32_t i = 1; i < num_rows; ++i) {
+        uint32_t node_id = rank_to_node_id[i - 1];
+
+        predecessors_[i].clear();
+        int64_t position = positions_[0];
+        for (const auto& it: nodes[node_id]->in_edges()) {
+            uint32_t row = node_id_to_rank_[it->begin_node_id()] + 1;
+            predecessors_[i].emplace_back(row);
+            position = std::max(position, positions_[row]);
+        }
+        if (predecessors_[i].empty()) {
+            predecessors_[i].emplace_back(0);
+        }
+
+        uint32_t id = mapping.empty() ? node_id : mapping[node_id];
+        positions_[i] = id <= end ? id : position + 1;
+    }
+
+    band_begins_.resize(num_rows);
+    band_ends_.resize(num_rows);
+    offsets_.resize(num_rows + 1);
+    band_begins_[0] = 0;
+    band_ends_[0] = sequence_length;
+    offsets_[0] = 0;
+    offsets_[1] = num_columns;
+    uint64_t span = static_cast<uint64_t>(end) - begin + 1;
+    for (uint32_t i = 1; i < num_rows; ++i) {
+        int64_t offset = positions_[i] - begin + 1;
+        uint32_t diagonal = offset <= 0 ? 0 : std::min<uint64_t>(sequence_length,
+            static_cast<uint64_t>(offset) * sequence_length / span);
+        band_begins_[i] = diagonal > band_width_ ? diagonal - band_width_ : 0;
+        band_ends_[i] = std::min(sequence_length, diagonal + band_width_);
+        offsets_[i + 1] = offsets_[i] + band_ends_[i] - band_begins_[i] + 1;
+    }
+    matrix_.resize(offsets_[num_rows]);
+
+    profile_.resize(graph->num_codes() * num_columns);
+    for (uint32_t c = 0; c < graph->num_codes(); ++c) {
+        char base = graph->decoder(c);
+        int32_t* profile = &profile_[c * num_columns];
+        profile[0] = kNegativeInfinity;
+        for (uint32_t j = 1; j < num_columns; ++j) {
+            profile[j] = base == sequence[j - 1] ? match_ : mismatch_;
+        }
+    }
+
+    for (uint32_t j = 0; j < num_columns; ++j) {
+        matrix_[j] = static_cast<int32_t>(j) * gap_;
+    }
+
+    // rows are indexed by columns, cells outside of the band of a predecessor
+    // are never read so that the kernels do not branch
+    for (uint32_t i = 1; i < num_rows; ++i) {
+        uint32_t first = band_begins_[i], last = band_ends_[i];
+        int32_t* row = &matrix_[offsets_[i] - first];
+        const int32_t* profile = &profile_[nodes[rank_to_node_id[i - 1]]->code() *
+            num_columns];
+
+        std::fill(row + first, row + last + 1, kNegativeInfinity);
+        for (const auto& it: predecessors_[i]) {
+            kernels_.banded_predecessor(row,
+                &matrix_[offsets_[it] - band_begins_[it]], profile, gap_, first,
+                last, band_begins_[it], band_ends_[it]);
+        }
+        kernels_.banded_insertions(row, gap_, first, last);
+    }
+
+    // global alignment ends in a sink node after the whole sequence
+    uint32_t i = 0, j = sequence_length;
+    int32_t max_score = kNegativeInfinity / 2;
+    for (uint32_t k = 1; k < num_rows; ++k) {
+        if (nodes[rank_to_node_id[k - 1]]->out_edges().empty() &&
+            score(k, j) > max_score) {
+            max_score = score(k, j);
+            i = k;
+        }
+    }
+    if (i == 0) {
+        return false;
+    }
+
+    while (i != 0 || j != 0) {
+        if (i == 0) {
+            dst.emplace_back(-1, --j);
+            continue;
+        }
+        if ((j == band_begins_[i] && j != 0) ||
+            (j == band_ends_[i] && j != sequence_length)) {
+            dst.clear();
+            return false;
+        }
+
+        int32_t node_id = rank_to_node_id[i - 1];
+        int32_t h = score(i, j);
+        const int32_t* profile = &profile_[nodes[node_id]->code() * num_columns];
+
+        // ties are broken as in spoa, i.e. a match or mismatch with any
+        // predecessor is preferred over a deletion, which is preferred over
+        // an insertion
+        uint32_t predecessor = 0;
+        bool is_found = false;
+        if (j > 0) {
+            for (const auto& it: predecessors_[i]) {
+                if (score(it, j - 1) + profile[j] == h) {
+                    predecessor = it;
+                    is_found = true;
+                    break;
+                }
+            }
+        }
+        if (is_found) {
+            dst.emplace_back(node_id, --j);
+            i = predecessor;
+            continue;
+        }
+        for (const auto& it: predecessors_[i]) {
+            if (score(it, j) + gap_ == h) {
+                predecessor = it;
+                is_found = true;
+                break;
+            }
+        }
+        if (is_found) {
+            dst.emplace_back(node_id, -1);
+            i = predecessor;
+            continue;
+        }
+        if (j > 0 && score(i, j - 1) + gap_ == h) {
+            dst.emplace_back(-1, --j);
+        } else {
+            dst.clear();
+            return false;
+        }
+    }
+
+    std::reverse(dst.begin(), dst.end());
+    return true;
+}
+
+}
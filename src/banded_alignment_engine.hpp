@@ -0,0 +1,90 @@
+/*!
+ * @file banded_alignment_engine.hpp
+ *
+ * @brief BandedAlignmentEngine class header file
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include <utility>
+
+namespace spoa {
+    class Graph;
+}
+
+namespace racon {
+
+struct Kernels;
+
+class BandedAlignmentEngine;
+std::unique_ptr<BandedAlignmentEngine> createBandedAlignmentEngine(int8_t match,
+    int8_t mismatch, int8_t gap);
+
+/*!
+ * @brief Global partial order alignment with linear gaps restricted to a band
+ * around the expected diagonal, i.e. the position of each node on the
+ * backbone (the first sequence of the graph) scaled to the layer's span
+ */
+class BandedAlignmentEngine {
+public:
+    ~BandedAlignmentEngine() = default;
+
+    uint32_t band_width() const {
+        return band_width_;
+    }
+
+    /*!
+     * @brief Sets the number of cells on each side of the diagonal which are
+     * computed (0 disables banding)
+     */
+    void set_band_width(uint32_t band_width) {
+        band_width_ = band_width;
+    }
+
+    /*!
+     * @brief Aligns the sequence, which spans backbone positions [begin, end],
+     * to the graph and stores pairs of node ids and sequence positions (-1 for
+     * gaps) in dst; mapping translates node ids of a subgraph to the graph it
+     * was created from (empty if the graph is not a subgraph); returns false
+     * if banding is disabled or the alignment touches the band edge (i.e. it
+     * might not be optimal and should be recomputed without a band)
+     */
+    bool align(const char* sequence, uint32_t sequence_length,
+        const std::unique_ptr<spoa::Graph>& graph, uint32_t begin, uint32_t end,
+        const std::vector<int32_t>& mapping,
+        std::vector<std::pair<int32_t, int32_t>>& dst);
+
+    friend std::unique_ptr<BandedAlignmentEngine> createBandedAlignmentEngine(
+        int8_t match, int8_t mismatch, int8_t gap);
+private:
+    BandedAlignmentEngine(int8_t match, int8_t mismatch, int8_t gap);
+    BandedAlignmentEngine(const BandedAlignmentEngine&) = delete;
+    const BandedAlignmentEngine& operator=(const BandedAlignmentEngine&) = delete;
+
+    int32_t score(uint32_t row, uint32_t column) const;
+
+    int8_t match_;
+    int8_t mismatch_;
+    int8_t gap_;
+    uint32_t band_width_;
+
+    // row 0 is the virtual source, row i + 1 belongs to the node of rank i;
+    // only cells [band_begins_[i], band_ends_[i]] of each row are stored,
+    // rows follow each other in matrix_
+    std::vector<uint32_t> node_id_to_rank_;
+    std::vector<int64_t> positions_;
+    std::vector<uint32_t> band_begins_;
+    std::vector<uint32_t> band_ends_;
+    std::vector<uint64_t> offsets_;
+    std::vector<int32_t> matrix_;
+    std::vector<std::vector<uint32_t>> predecessors_;
+    // match or mismatch score of each code against each sequence position
+    std::vector<int32_t> profile_;
+
+    const Kernels& kernels_;
+};
+
+}
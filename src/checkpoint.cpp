@@ -0,0 +1,230 @@
+/*!
+ * @file checkpoint.cpp
+ *
+ * @brief Checkpoint class source file
+ */
+
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <zlib.h>
+
+#include <chrono>
+
+#include "window.hpp"
+#include "checkpoint.hpp"
+
+namespace racon {
+
+static const std::string kMagic = "RACON_CHECKPOINT_V2";
+constexpr int64_t kFlushInterval = 10; // seconds
+constexpr uint32_t kMaxFieldLength = 1U << 30;
+
+static std::string windowKey(const std::string& name, uint32_t rank) {
+    std::string key = name;
+    key += '\0';
+    key += std::to_string(rank);
+    return key;
+}
+
+static bool readField(FILE* file, void* dst, uint64_t size) {
+    return fread(dst, 1, size, file) == size;
+}
+
+// reads a field of a record and updates the record checksum
+static bool readField(FILE* file, void* dst, uint64_t size, uLong& crc) {
+    if (!readField(file, dst, size)) {
+        return false;
+    }
+    crc = crc32(crc, static_cast<const Bytef*>(dst), size);
+    return true;
+}
+
+static void appendField(std::string& dst, const void* src, uint64_t size) {
+    dst.append(static_cast<const char*>(src), size);
+}
+
+static int64_t steadyTime() {
+    return std::chrono::duration_cast<std::chrono::seconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+std::unique_ptr<Checkpoint> createCheckpoint(const std::string& directory,
+    const std::string& signature) {
+
+    if (directory.empty()) {
+        fprintf(stderr, "[racon::createCheckpoint] error: "
+            "empty checkpoint directory path!\n");
+        exit(1);
+    }
+
+    if (mkdir(directory.c_str(), 0755) != 0 && errno != EEXIST) {
+        fprintf(stderr, "[racon::createCheckpoint] error: "
+            "unable to create directory %s!\n", directory.c_str());
+        exit(1);
+    }
+
+    return std::unique_ptr<Checkpoint>(new Checkpoint(directory +
+        "/racon.checkpoint", signature));
+}
+
+Checkpoint::Checkpoint(const std::string& path, const std::string& signature)
+        : path_(path), signature_(signature), file_(nullptr), mutex_(),
+        flush_time_(steadyTime()), windows_() {
+}
+
+Checkpoint::~Checkpoint() {
+    if (file_ != nullptr) {
+        fclose(file_);
+    }
+}
+
+void Checkpoint::open(const std::string& options) {
+    if (file_ != nullptr) {
+        return;
+    }
+    load(signature_ + options);
+}
+
+void Checkpoint::load(const std::string& signature) {
+
+    long valid_size = 0;
+
+    FILE* file = fopen(path_.c_str(), "rb");
+    if (file != nullptr) {
+        std::string magic(kMagic.size(), '\0');
+        uint32_t signature_length = 0;
+
+        bool is_valid = readField(file, &magic[0], magic.size()) &&
+            magic == kMagic && readField(file, &signature_length,
+            sizeof(signature_length)) && signature_length < kMaxFieldLength;
+
+        std::string stored_signature(is_valid ? signature_length : 0, '\0');
+        is_valid = is_valid && readField(file, &stored_signature[0],
+            stored_signature.size());
+
+        if (!is_valid) {
+            fprintf(stderr, "[racon::Checkpoint::load] error: "
+                "invalid checkpoint file %s!\n", path_.c_str());
+            exit(1);
+        }
+        if (stored_signature != signature) {
+            fprintf(stderr, "[racon::Checkpoint::load] error: "
+                "checkpoint file %s was created with different input files or "
+                "parameters!\n", path_.c_str());
+            exit(1);
+        }
+        valid_size = ftell(file);
+
+        // records are appended one by one, a truncated or corrupted tail is
+        // discarded
+        while (true) {
+            uint32_t name_length = 0, rank = 0, consensus_length = 0, stored_crc = 0;
+            uint8_t is_polished = 0;
+            uLong crc = crc32(0L, Z_NULL, 0);
+
+            if (!readField(file, &name_length, sizeof(name_length), crc) ||
+                name_length >= kMaxFieldLength) {
+                break;
+            }
+            std::string name(name_length, '\0');
+            if (!readField(file, &name[0], name_length, crc) ||
+                !readField(file, &rank, sizeof(rank), crc) ||
+                !readField(file, &is_polished, sizeof(is_polished), crc) ||
+                !readField(file, &consensus_length, sizeof(consensus_length), crc) ||
+                consensus_length >= kMaxFieldLength) {
+                break;
+            }
+            std::string consensus(consensus_length, '\0');
+            if (!readField(file, &consensus[0], consensus_length, crc) ||
+                !readField(file, &stored_crc, sizeof(stored_crc)) ||
+                stored_crc != static_cast<uint32_t>(crc)) {
+                break;
+            }
+
+            windows_[windowKey(name, rank)] = std::make_pair(is_polished != 0,
+                std::move(consensus));
+            valid_size = ftell(file);
+        }
+
+        fclose(file);
+    }
+
+    if (valid_size == 0) {
+        file_ = fopen(path_.c_str(), "wb");
+        if (file_ == nullptr) {
+            fprintf(stderr, "[racon::Checkpoint::load] error: "
+                "unable to create file %s!\n", path_.c_str());
+            exit(1);
+        }
+
+        uint32_t signature_length = signature.size();
+        fwrite(kMagic.data(), 1, kMagic.size(), file_);
+        fwrite(&signature_length, sizeof(signature_length), 1, file_);
+        fwrite(signature.data(), 1, signature.size(), file_);
+        fflush(file_);
+    } else {
+        if (truncate(path_.c_str(), valid_size) != 0 ||
+            (file_ = fopen(path_.c_str(), "ab")) == nullptr) {
+            fprintf(stderr, "[racon::Checkpoint::load] error: "
+                "unable to open file %s for appending!\n", path_.c_str());
+            exit(1);
+        }
+
+        fprintf(stderr, "[racon::Checkpoint::load] loaded %zu windows from %s\n",
+            windows_.size(), path_.c_str());
+    }
+}
+
+bool Checkpoint::contains(const std::string& name, uint32_t rank) const {
+    return windows_.find(windowKey(name, rank)) != windows_.end();
+}
+
+bool Checkpoint::restore(const std::string& name, Window& window,
+    bool& is_polished) {
+
+    auto it = windows_.find(windowKey(name, window.rank()));
+    if (it == windows_.end()) {
+        return false;
+    }
+
+    is_polished = it->second.first;
+    window.consensus_.swap(it->second.second);
+    windows_.erase(it);
+
+    return true;
+}
+
+void Checkpoint::store(const std::string& name, const Window& window,
+    bool is_polished) {
+
+    uint32_t name_length = name.size();
+    uint32_t rank = window.rank();
+    uint8_t polished = is_polished ? 1 : 0;
+    uint32_t consensus_length = window.consensus().size();
+
+    // each record is followed by its checksum
+    std::string record;
+    appendField(record, &name_length, sizeof(name_length));
+    appendField(record, name.data(), name.size());
+    appendField(record, &rank, sizeof(rank));
+    appendField(record, &polished, sizeof(polished));
+    appendField(record, &consensus_length, sizeof(consensus_length));
+    appendField(record, window.consensus().data(), window.consensus().size());
+    uint32_t crc = crc32(crc32(0L, Z_NULL, 0),
+        reinterpret_cast<const Bytef*>(record.data()), record.size());
+
+    std::lock_guard<std::mutex> lock(mutex_);
+
+    fwrite(record.data(), 1, record.size(), file_);
+    fwrite(&crc, sizeof(crc), 1, file_);
+
+    int64_t now = steadyTime();
+    if (now - flush_time_ >= kFlushInterval) {
+        fflush(file_);
+        flush_time_ = now;
+    }
+}
+
+}
@@ -0,0 +1,74 @@
+/*!
+ * @file checkpoint.hpp
+ *
+ * @brief Checkpoint class header file
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+namespace racon {
+
+class Window;
+
+class Checkpoint;
+std::unique_ptr<Checkpoint> createCheckpoint(const std::string& directory,
+    const std::string& signature);
+
+class Checkpoint {
+public:
+    ~Checkpoint();
+
+    uint64_t size() const {
+        return windows_.size();
+    }
+
+    /*!
+     * @brief Loads windows persisted by a run with the same input files and
+     * options, which are appended to the signature as they might be set only
+     * after creation (does nothing if already opened)
+     */
+    void open(const std::string& options);
+
+    /*!
+     * @brief Checks whether the consensus of a window was already persisted
+     */
+    bool contains(const std::string& name, uint32_t rank) const;
+
+    /*!
+     * @brief Moves the persisted consensus into the window (if present) and
+     * stores whether the window was polished in is_polished
+     */
+    bool restore(const std::string& name, Window& window, bool& is_polished);
+
+    /*!
+     * @brief Appends the consensus of a window to the checkpoint file
+     * (thread safe, the file is flushed periodically)
+     */
+    void store(const std::string& name, const Window& window, bool is_polished);
+
+    friend std::unique_ptr<Checkpoint> createCheckpoint(const std::string& directory,
+        const std::string& signature);
+private:
+    Checkpoint(const std::string& path, const std::string& signature);
+    Checkpoint(const Checkpoint&) = delete;
+    const Checkpoint& operator=(const Checkpoint&) = delete;
+
+    void load(const std::string& signature);
+
+    std::string path_;
+    std::string signature_;
+    FILE* file_;
+    std::mutex mutex_;
+    int64_t flush_time_;
+    std::unordered_map<std::string, std::pair<bool, std::string>> windows_;
+};
+
+}
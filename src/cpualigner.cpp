@@ -0,0 +1,297 @@
+/*!
+ * @file cpualigner.cpp
+ *
+ * @brief CPU batch aligner class source file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <string>
+
+#include "alphabet.hpp"
+#include "overlap.hpp"
+#include "sequence.hpp"
+#include "cpualigner.hpp"
+
+namespace racon {
+
+constexpr uint32_t kNumLanes = 8;
+// bounds the traceback workspace (two bits per cell and lane)
+constexpr uint64_t kMaxCells = 1ULL << 24;
+constexpr int32_t kInfinity = std::numeric_limits<int32_t>::max() / 2;
+
+// GCC and Clang vector extension, operations are done on all lanes at once
+typedef int32_t Lanes __attribute__((vector_size(kNumLanes * sizeof(int32_t)),
+    __may_alias__));
+typedef uint32_t Bits __attribute__((vector_size(kNumLanes * sizeof(uint32_t)),
+    __may_alias__));
+
+// vectors are passed by reference only, which keeps the ABI independent of
+// the instruction set
+inline void lanesBroadcast(Lanes& dst, int32_t value) {
+    for (uint32_t k = 0; k < kNumLanes; ++k) {
+        dst[k] = value;
+    }
+}
+
+inline void lanesMin(Lanes& dst, const Lanes& src) {
+    Lanes mask = src < dst;
+    dst = (src & mask) | (dst & ~mask);
+}
+
+// returns storage as num_vectors vectors aligned to the vector size
+template<typename V, typename T>
+V* alignedLanes(std::vector<T>& storage, uint64_t num_vectors) {
+    uint64_t size = (num_vectors + 1) * kNumLanes;
+    if (storage.size() < size) {
+        storage.resize(size);
+    }
+    uintptr_t address = reinterpret_cast<uintptr_t>(storage.data());
+    address = (address + sizeof(V) - 1) / sizeof(V) * sizeof(V);
+    return reinterpret_cast<V*>(address);
+}
+
+std::unique_ptr<CPUBatchAligner> createCPUBatchAligner(double error_threshold) {
+
+    if (error_threshold < 0) {
+        fprintf(stderr, "[racon::createCPUBatchAligner] error: "
+            "invalid error threshold!\n");
+        exit(1);
+    }
+
+    return std::unique_ptr<CPUBatchAligner>(new CPUBatchAligner(error_threshold));
+}
+
+CPUBatchAligner::CPUBatchAligner(double error_threshold)
+        : error_threshold_(error_threshold), overlaps_(), queries_(), queries_lengths_(), queries_reversed_(), targets_(),
+        targets_lengths_(), lower_width_(0), upper_width_(0), num_rows_(0),
+        storage_(), directions_(), operations_() {
+}
+
+CPUBatchAligner::~CPUBatchAligner() {
+}
+
+bool CPUBatchAligner::addOverlap(Overlap* overlap,
+    std::vector<std::unique_ptr<Sequence>>& sequences) {
+
+    if (overlaps_.size() == kNumLanes) {
+        return false;
+    }
+    if (!overlap->cigar_.empty() || !overlap->breaking_points_.empty()) {
+        return true;
+    }
+
+    uint32_t q_length = overlap->q_end_ - overlap->q_begin_;
+    uint32_t t_length = overlap->t_end_ - overlap->t_begin_;
+    if (q_length == 0 || t_length == 0) {
+        return true;
+    }
+
+    const auto& q_codes = sequences[overlap->q_id_]->codes();
+    const auto& t_codes = sequences[overlap->t_id_]->codes();
+    if (q_codes.empty() || t_codes.empty()) {
+        return true;
+    }
+
+    // the band has to contain the last cell of each lane and as many edits
+    // on either side as the error threshold allows (plus the edge cell)
+    uint32_t band_width = std::ceil(error_threshold_ * std::max(q_length,
+        t_length)) + 1;
+    uint32_t lower_width = std::max(lower_width_, band_width +
+        (t_length > q_length ? t_length - q_length : 0));
+    uint32_t upper_width = std::max(upper_width_, band_width +
+        (q_length > t_length ? q_length - t_length : 0));
+    uint32_t num_rows = std::max(num_rows_, t_length + 1);
+    if (static_cast<uint64_t>(num_rows) * (lower_width + upper_width + 1) > kMaxCells) {
+        return overlaps_.empty();
+    }
+
+    lower_width_ = lower_width;
+    upper_width_ = upper_width;
+    num_rows_ = num_rows;
+
+    overlaps_.emplace_back(overlap);
+    queries_.emplace_back(!overlap->strand_ ? &(q_codes[overlap->q_begin_]) :
+        &(q_codes[overlap->q_end_ - 1]));
+    queries_lengths_.emplace_back(q_length);
+    queries_reversed_.emplace_back(overlap->strand_);
+    targets_.emplace_back(&(t_codes[overlap->t_begin_]));
+    targets_lengths_.emplace_back(t_length);
+
+    return true;
+}
+
+bool CPUBatchAligner::hasOverlaps() const {
+    return !overlaps_.empty();
+}
+
+uint32_t CPUBatchAligner::max_overlaps() const {
+    return kNumLanes;
+}
+
+void CPUBatchAligner::reset() {
+    overlaps_.clear();
+    queries_.clear();
+    queries_lengths_.clear();
+    queries_reversed_.clear();
+    targets_.clear();
+    targets_lengths_.clear();
+    lower_width_ = 0;
+    upper_width_ = 0;
+    num_rows_ = 0;
+}
+
+void CPUBatchAligner::alignAll() {
+
+    if (overlaps_.empty()) {
+        return;
+    }
+
+    // row i belongs to target position i, cell b of each row to query
+    // position j = i + b - lower_width_ (i.e. cells on a diagonal share b)
+    uint32_t band = lower_width_ + upper_width_ + 1;
+    uint32_t num_words = (band + 31) / 32;
+    uint64_t num_queries = num_rows_ + band;
+
+    Lanes* queries = alignedLanes<Lanes>(storage_, num_queries + 2 * band);
+    Lanes* previous = queries + num_queries;
+    Lanes* current = previous + band;
+    Bits* directions = alignedLanes<Bits>(directions_,
+        static_cast<uint64_t>(num_rows_) * num_words * 2);
+
+    // queries[i + b] holds code j - 1 of each query, padding never matches
+    for (uint64_t x = 0; x < num_queries; ++x) {
+        int64_t j = static_cast<int64_t>(x) - lower_width_;
+        for (uint32_t k = 0; k < kNumLanes; ++k) {
+            if (k >= overlaps_.size() || j < 1 || j > queries_lengths_[k]) {
+                queries[x][k] = -1;
+            } else if (queries_reversed_[k]) {
+                queries[x][k] = complementCode(*(queries_[k] - (j - 1)));
+            } else {
+                queries[x][k] = queries_[k][j - 1];
+            }
+        }
+    }
+
+    Lanes one, infinity;
+    lanesBroadcast(one, 1);
+    lanesBroadcast(infinity, kInfinity);
+
+    for (uint32_t b = 0; b < band; ++b) {
+        lanesBroadcast(current[b], b < lower_width_ ? kInfinity :
+            static_cast<int32_t>(b - lower_width_));
+    }
+    for (uint32_t w = 0; w < 2 * num_words; ++w) {
+        directions[w] = Bits();
+    }
+
+    for (uint32_t i = 1; i < num_rows_; ++i) {
+        std::swap(previous, current);
+
+        // unknown bases stand for different characters and never match,
+        // not even each other (padding of targets and queries differs too)
+        Lanes target;
+        for (uint32_t k = 0; k < kNumLanes; ++k) {
+            target[k] = k < overlaps_.size() && i <= targets_lengths_[k] &&
+                targets_[k][i - 1] != kUnknownCode ? targets_[k][i - 1] : -2;
+        }
+
+        Bits* row_directions = directions + static_cast<uint64_t>(i) * num_words * 2;
+        Bits diagonals = Bits(), ups = Bits();
+        for (uint32_t b = 0; b < band; ++b) {
+            int64_t j = static_cast<int64_t>(i) + b - lower_width_;
+            uint32_t bit = 1U << (b & 31);
+
+            if (j < 0) {
+                current[b] = infinity;
+            } else if (j == 0) {
+                lanesBroadcast(current[b], i);
+                ups |= bit;
+            } else {
+                // equal bases give -1
+                Lanes diagonal = previous[b] + one + (queries[i + b] == target);
+                Lanes up = b + 1 < band ? previous[b + 1] + one : infinity;
+                Lanes left = b > 0 ? current[b - 1] + one : infinity;
+
+                Lanes h = diagonal;
+                lanesMin(h, up);
+                lanesMin(h, left);
+                current[b] = h;
+
+                // ties prefer a match or mismatch, then a deletion
+                Bits is_diagonal = (Bits) (h == diagonal);
+                Bits is_up = (Bits) (h == up) & ~is_diagonal;
+                diagonals |= is_diagonal & bit;
+                ups |= is_up & bit;
+            }
+
+            if ((b & 31) == 31 || b + 1 == band) {
+                row_directions[(b / 32) * 2] = diagonals;
+                row_directions[(b / 32) * 2 + 1] = ups;
+                diagonals = Bits();
+                ups = Bits();
+            }
+        }
+    }
+
+    for (uint32_t k = 0; k < overlaps_.size(); ++k) {
+        traceback(k, reinterpret_cast<const uint32_t*>(directions));
+    }
+}
+
+void CPUBatchAligner::traceback(uint32_t lane, const uint32_t* directions) {
+
+    uint32_t band = lower_width_ + upper_width_ + 1;
+    uint32_t num_words = (band + 31) / 32;
+
+    operations_.clear();
+    uint32_t i = targets_lengths_[lane], j = queries_lengths_[lane];
+    while (i != 0 || j != 0) {
+        if (i == 0) {
+            operations_ += 'I';
+            --j;
+            continue;
+        }
+        if (j == 0) {
+            operations_ += 'D';
+            --i;
+            continue;
+        }
+
+        uint32_t b = j + lower_width_ - i;
+        if (b == 0 || b == band - 1) {
+            return;
+        }
+
+        const uint32_t* word = directions + ((static_cast<uint64_t>(i) *
+            num_words + b / 32) * 2) * kNumLanes;
+        uint32_t bit = 1U << (b & 31);
+        if (word[lane] & bit) {
+            operations_ += 'M';
+            --i;
+            --j;
+        } else if (word[kNumLanes + lane] & bit) {
+            operations_ += 'D';
+            --i;
+        } else {
+            operations_ += 'I';
+            --j;
+        }
+    }
+
+    // operations are stored from the end
+    auto& cigar = overlaps_[lane]->cigar_;
+    cigar.clear();
+    for (uint32_t l = operations_.size(), r = l; l > 0; l = r) {
+        while (r > 0 && operations_[r - 1] == operations_[l - 1]) {
+            --r;
+        }
+        cigar += std::to_string(l - r) + operations_[l - 1];
+    }
+}
+
+}
@@ -0,0 +1,85 @@
+/*!
+ * @file cpualigner.hpp
+ *
+ * @brief CPU batch aligner class header file
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include <string>
+
+namespace racon {
+
+class Overlap;
+class Sequence;
+
+class CPUBatchAligner;
+std::unique_ptr<CPUBatchAligner> createCPUBatchAligner(double error_threshold);
+
+/*!
+ * @brief Aligns several overlaps at once (modeled on CUDABatchAligner); each
+ * overlap occupies a SIMD lane of a single edit distance DP restricted to a
+ * diagonal band wide enough for error_threshold edits per base, workspaces are
+ * kept between batches
+ */
+class CPUBatchAligner {
+public:
+    ~CPUBatchAligner();
+
+    /*!
+     * @brief Adds an overlap to the batch, returns false if the batch is full;
+     * overlaps which do not fit into an empty batch or whose sequences are not
+     * encoded (see Sequence::encode) are skipped and left to
+     * Overlap::find_breaking_points
+     */
+    bool addOverlap(Overlap* overlap, std::vector<std::unique_ptr<Sequence>>& sequences);
+
+    bool hasOverlaps() const;
+
+    uint32_t max_overlaps() const;
+
+    /*!
+     * @brief Aligns all overlaps in the batch and stores their cigar strings;
+     * alignments touching the band edge might not be optimal and are left to
+     * Overlap::find_breaking_points
+     */
+    void alignAll();
+
+    void reset();
+
+    friend std::unique_ptr<CPUBatchAligner> createCPUBatchAligner(
+        double error_threshold);
+private:
+    CPUBatchAligner(double error_threshold);
+    CPUBatchAligner(const CPUBatchAligner&) = delete;
+    const CPUBatchAligner& operator=(const CPUBatchAligner&) = delete;
+
+    // fills cigar of the overlap in lane, which is left empty if the
+    // alignment touches the band edge
+    void traceback(uint32_t lane, const uint32_t* directions);
+
+    double error_threshold_;
+
+    std::vector<Overlap*> overlaps_;
+    // reverse complemented queries are read backwards from their last code
+    std::vector<const uint8_t*> queries_;
+    std::vector<uint32_t> queries_lengths_;
+    std::vector<bool> queries_reversed_;
+    std::vector<const uint8_t*> targets_;
+    std::vector<uint32_t> targets_lengths_;
+
+    // band covers diagonals [-lower_width_, upper_width_] of all lanes
+    uint32_t lower_width_;
+    uint32_t upper_width_;
+    uint32_t num_rows_;
+
+    // lane interleaved queries, score rows and traceback bits
+    std::vector<int32_t> storage_;
+    std::vector<uint32_t> directions_;
+    std::string operations_;
+};
+
+}
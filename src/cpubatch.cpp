@@ -0,0 +1,317 @@
+/*!
+ * @file cpubatch.cpp
+ *
+ * @brief CPU batch class source file
+ */
+
+#include <algorithm>
+#include <limits>
+
+#include "window.hpp"
+#include "kernels.hpp"
+#include "cpubatch.hpp"
+
+#include "spoa/spoa.hpp"
+
+namespace racon {
+
+constexpr int32_t kNegativeInfinity = std::numeric_limits<int32_t>::min() / 2;
+
+inline void lanesBroadcast(Lanes& dst, int32_t value) {
+    for (uint32_t k = 0; k < kNumLanes; ++k) {
+        dst[k] = value;
+    }
+}
+
+std::unique_ptr<CPUBatchProcessor> createCPUBatch(int8_t match, int8_t mismatch,
+    int8_t gap, bool trim) {
+
+    return std::unique_ptr<CPUBatchProcessor>(new CPUBatchProcessor(match,
+        mismatch, gap, trim));
+}
+
+CPUBatchProcessor::CPUBatchProcessor(int8_t match, int8_t mismatch, int8_t gap,
+    bool trim)
+        : match_(match), mismatch_(mismatch), gap_(gap), trim_(trim), windows_(),
+        window_consensus_status_(), graphs_(kNumLanes, nullptr),
+        sequences_(kNumLanes, nullptr), sequences_lengths_(kNumLanes, 0),
+        node_id_to_rank_(kNumLanes), alignments_(kNumLanes), storage_(),
+        matrix_(nullptr), kernels_(selectKernels()) {
+}
+
+CPUBatchProcessor::~CPUBatchProcessor() {
+}
+
+bool CPUBatchProcessor::addWindow(std::shared_ptr<Window> window) {
+    if (isFull()) {
+        return false;
+    }
+    windows_.emplace_back(window);
+    return true;
+}
+
+bool CPUBatchProcessor::hasWindows() const {
+    return !windows_.empty();
+}
+
+bool CPUBatchProcessor::isFull() const {
+    return windows_.size() == kNumLanes;
+}
+
+uint32_t CPUBatchProcessor::max_windows() const {
+    return kNumLanes;
+}
+
+void CPUBatchProcessor::reset() {
+    windows_.clear();
+    window_consensus_status_.clear();
+}
+
+const std::vector<bool>& CPUBatchProcessor::generateConsensus() {
+
+    window_consensus_status_.assign(windows_.size(), false);
+
+    std::vector<std::unique_ptr<spoa::Graph>> graphs(windows_.size());
+    std::vector<std::vector<uint32_t>> layers(windows_.size());
+    uint32_t num_steps = 0;
+    for (uint32_t k = 0; k < windows_.size(); ++k) {
+        auto& window = *windows_[k];
+        if (window.sequences_.size() < 3) {
+            window.consensus_ = std::string(window.sequences_.front().first,
+                window.sequences_.front().second);
+            continue;
+        }
+        graphs[k] = window.create_graph();
+        layers[k] = window.sorted_layers();
+        num_steps = std::max<uint32_t>(num_steps, layers[k].size());
+    }
+
+    std::vector<std::unique_ptr<spoa::Graph>> subgraphs(windows_.size());
+    std::vector<std::vector<int32_t>> mappings(windows_.size());
+    for (uint32_t step = 0; step < num_steps; ++step) {
+        for (uint32_t k = 0; k < kNumLanes; ++k) {
+            graphs_[k] = nullptr;
+            if (k >= windows_.size() || step >= layers[k].size()) {
+                continue;
+            }
+            const auto& window = *windows_[k];
+            uint32_t i = layers[k][step];
+
+            if (window.is_spanning(i)) {
+                subgraphs[k].reset();
+                graphs_[k] = graphs[k].get();
+            } else {
+                mappings[k].clear();
+                subgraphs[k] = graphs[k]->subgraph(window.positions_[i].first,
+                    window.positions_[i].second, mappings[k]);
+                graphs_[k] = subgraphs[k].get();
+            }
+            sequences_[k] = window.sequences_[i].first;
+            sequences_lengths_[k] = window.sequences_[i].second;
+        }
+
+        align();
+
+        for (uint32_t k = 0; k < windows_.size(); ++k) {
+            if (graphs_[k] == nullptr) {
+                continue;
+            }
+            if (subgraphs[k] != nullptr) {
+                subgraphs[k]->update_alignment(alignments_[k], mappings[k]);
+            }
+            windows_[k]->add_alignment(graphs[k], alignments_[k],
+                layers[k][step]);
+        }
+    }
+
+    for (uint32_t k = 0; k < windows_.size(); ++k) {
+        if (graphs[k] == nullptr) {
+            continue;
+        }
+        windows_[k]->create_consensus(graphs[k], trim_);
+        window_consensus_status_[k] = true;
+    }
+
+    return window_consensus_status_;
+}
+
+void CPUBatchProcessor::align() {
+
+    uint32_t num_rows = 1, num_columns = 1;
+    for (uint32_t k = 0; k < kNumLanes; ++k) {
+        if (graphs_[k] == nullptr) {
+            continue;
+        }
+        const auto& rank_to_node_id = graphs_[k]->rank_to_node_id();
+        node_id_to_rank_[k].resize(graphs_[k]->nodes().size());
+        for (uint32_t i = 0; i < rank_to_node_id.size(); ++i) {
+            node_id_to_rank_[k][rank_to_node_id[i]] = i;
+        }
+        num_rows = std::max<uint32_t>(num_rows, rank_to_node_id.size() + 1);
+        num_columns = std::max(num_columns, sequences_lengths_[k] + 1);
+    }
+    if (num_rows == 1) {
+        return;
+    }
+
+    // sequences are followed by the matrix, both aligned to the vector size
+    uint64_t size = (static_cast<uint64_t>(num_rows) + 1) * num_columns * kNumLanes;
+    if (storage_.size() < size + kNumLanes) {
+        storage_.resize(size + kNumLanes);
+    }
+    uintptr_t address = reinterpret_cast<uintptr_t>(storage_.data());
+    address = (address + sizeof(Lanes) - 1) / sizeof(Lanes) * sizeof(Lanes);
+    Lanes* sequences = reinterpret_cast<Lanes*>(address);
+    Lanes* matrix = sequences + num_columns;
+    matrix_ = reinterpret_cast<int32_t*>(matrix);
+
+    // padding never matches a base
+    for (uint32_t j = 0; j < num_columns; ++j) {
+        for (uint32_t k = 0; k < kNumLanes; ++k) {
+            sequences[j][k] = j > 0 && j <= sequences_lengths_[k] &&
+                graphs_[k] != nullptr ? sequences_[k][j - 1] : -1;
+        }
+        lanesBroadcast(matrix[j], static_cast<int32_t>(j) * gap_);
+    }
+
+    Lanes negative_infinity;
+    lanesBroadcast(negative_infinity, kNegativeInfinity);
+
+    // predecessor rows shared by lanes are processed together
+    std::vector<std::pair<uint32_t, uint32_t>> predecessors;
+    auto add_predecessor = [&](uint32_t row, uint32_t lane) -> void {
+        for (auto& it: predecessors) {
+            if (it.first == row) {
+                it.second |= 1U << lane;
+                return;
+            }
+        }
+        predecessors.emplace_back(row, 1U << lane);
+    };
+
+    for (uint32_t i = 1; i < num_rows; ++i) {
+        Lanes base;
+        lanesBroadcast(base, -2);
+        predecessors.clear();
+        for (uint32_t k = 0; k < kNumLanes; ++k) {
+            if (graphs_[k] == nullptr || i > graphs_[k]->rank_to_node_id().size()) {
+                add_predecessor(0, k);
+                continue;
+            }
+            const auto& node = graphs_[k]->nodes()[
+                graphs_[k]->rank_to_node_id()[i - 1]];
+            base[k] = graphs_[k]->decoder(node->code());
+            if (node->in_edges().empty()) {
+                add_predecessor(0, k);
+            }
+            for (const auto& it: node->in_edges()) {
+                add_predecessor(node_id_to_rank_[k][it->begin_node_id()] + 1, k);
+            }
+        }
+
+        Lanes* row = matrix + i * num_columns;
+        for (uint32_t j = 0; j < num_columns; ++j) {
+            row[j] = negative_infinity;
+        }
+        for (const auto& it: predecessors) {
+            Lanes mask;
+            for (uint32_t k = 0; k < kNumLanes; ++k) {
+                mask[k] = (it.second >> k) & 1 ? -1 : 0;
+            }
+            kernels_.lanes_predecessor(row, matrix + it.first * num_columns,
+                sequences, &base, &mask, match_, mismatch_, gap_, num_columns);
+        }
+        kernels_.lanes_insertions(row, gap_, num_columns);
+    }
+
+    for (uint32_t k = 0; k < kNumLanes; ++k) {
+        if (graphs_[k] != nullptr) {
+            traceback(k, num_columns);
+        }
+    }
+}
+
+void CPUBatchProcessor::traceback(uint32_t lane, uint32_t num_columns) {
+
+    const auto& graph = graphs_[lane];
+    const auto& nodes = graph->nodes();
+    const auto& rank_to_node_id = graph->rank_to_node_id();
+    const auto& node_id_to_rank = node_id_to_rank_[lane];
+    const char* sequence = sequences_[lane];
+
+    auto score = [&](uint32_t i, uint32_t j) -> int32_t {
+        return matrix_[(static_cast<uint64_t>(i) * num_columns + j) * kNumLanes + lane];
+    };
+
+    auto& dst = alignments_[lane];
+    dst.clear();
+
+    // global alignment ends in a sink node after the whole sequence
+    uint32_t i = 0, j = sequences_lengths_[lane];
+    int32_t max_score = std::numeric_limits<int32_t>::min();
+    for (uint32_t k = 0; k < rank_to_node_id.size(); ++k) {
+        if (nodes[rank_to_node_id[k]]->out_edges().empty() &&
+            score(k + 1, j) > max_score) {
+            max_score = score(k + 1, j);
+            i = k + 1;
+        }
+    }
+
+    while (i != 0 || j != 0) {
+        if (i == 0) {
+            dst.emplace_back(-1, --j);
+            continue;
+        }
+
+        int32_t node_id = rank_to_node_id[i - 1];
+        const auto& node = nodes[node_id];
+        int32_t h = score(i, j);
+        char base = graph->decoder(node->code());
+
+        std::vector<uint32_t> predecessors;
+        for (const auto& it: node->in_edges()) {
+            predecessors.emplace_back(node_id_to_rank[it->begin_node_id()] + 1);
+        }
+        if (predecessors.empty()) {
+            predecessors.emplace_back(0);
+        }
+
+        // ties are broken as in spoa, i.e. a match or mismatch with any
+        // predecessor is preferred over a deletion, which is preferred over
+        // an insertion
+        uint32_t predecessor = 0;
+        bool is_found = false;
+        if (j > 0) {
+            int32_t substitution = base == sequence[j - 1] ? match_ : mismatch_;
+            for (const auto& it: predecessors) {
+                if (score(it, j - 1) + substitution == h) {
+                    predecessor = it;
+                    is_found = true;
+                    break;
+                }
+            }
+        }
+        if (is_found) {
+            dst.emplace_back(node_id, --j);
+            i = predecessor;
+            continue;
+        }
+        for (const auto& it: predecessors) {
+            if (score(it, j) + gap_ == h) {
+                predecessor = it;
+                is_found = true;
+                break;
+            }
+        }
+        if (is_found) {
+            dst.emplace_back(node_id, -1);
+            i = predecessor;
+            continue;
+        }
+        dst.emplace_back(-1, --j);
+    }
+
+    std::reverse(dst.begin(), dst.end());
+}
+
+}
@@ -0,0 +1,89 @@
+/*!
+ * @file cpubatch.hpp
+ *
+ * @brief CPU batch class header file
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+#include <utility>
+
+namespace spoa {
+    class Graph;
+}
+
+namespace racon {
+
+class Window;
+struct Kernels;
+
+class CPUBatchProcessor;
+std::unique_ptr<CPUBatchProcessor> createCPUBatch(int8_t match, int8_t mismatch,
+    int8_t gap, bool trim);
+
+/*!
+ * @brief Generates consensus of several windows at once (modeled on
+ * CUDABatchProcessor); in each step one layer of every window is aligned to
+ * its graph, with windows occupying separate SIMD lanes of a single DP
+ */
+class CPUBatchProcessor {
+public:
+    ~CPUBatchProcessor();
+
+    /*!
+     * @brief Adds a window to the batch, returns false if the batch is full
+     */
+    bool addWindow(std::shared_ptr<Window> window);
+
+    bool hasWindows() const;
+
+    bool isFull() const;
+
+    uint32_t max_windows() const;
+
+    /*!
+     * @brief Generates consensus of all windows in the batch and returns
+     * whether each of them was polished
+     */
+    const std::vector<bool>& generateConsensus();
+
+    void reset();
+
+    friend std::unique_ptr<CPUBatchProcessor> createCPUBatch(int8_t match,
+        int8_t mismatch, int8_t gap, bool trim);
+private:
+    CPUBatchProcessor(int8_t match, int8_t mismatch, int8_t gap, bool trim);
+    CPUBatchProcessor(const CPUBatchProcessor&) = delete;
+    const CPUBatchProcessor& operator=(const CPUBatchProcessor&) = delete;
+
+    // global alignment with linear gaps of each lane's sequence to its graph
+    // (lanes without a graph are skipped)
+    void align();
+    void traceback(uint32_t lane, uint32_t num_columns);
+
+    int8_t match_;
+    int8_t mismatch_;
+    int8_t gap_;
+    bool trim_;
+
+    std::vector<std::shared_ptr<Window>> windows_;
+    std::vector<bool> window_consensus_status_;
+
+    // per lane input and output of align
+    std::vector<const spoa::Graph*> graphs_;
+    std::vector<const char*> sequences_;
+    std::vector<uint32_t> sequences_lengths_;
+    std::vector<std::vector<uint32_t>> node_id_to_rank_;
+    std::vector<std::vector<std::pair<int32_t, int32_t>>> alignments_;
+
+    // lane interleaved sequences and DP matrix
+    std::vector<int32_t> storage_;
+    int32_t* matrix_;
+
+    const Kernels& kernels_;
+};
+
+}
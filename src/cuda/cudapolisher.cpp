@@ -11,6 +11,7 @@
 
 #include "sequence.hpp"
 #include "logger.hpp"
+#include "checkpoint.hpp"
 #include "cudapolisher.hpp"
 #include <claraparabricks/genomeworks/utils/cudautils.hpp>
 #include <algorithm>
@@ -24,16 +25,21 @@ namespace racon {
 // updates need to be broken into 20 bins.
 const uint32_t RACON_LOGGER_BIN_SIZE = 20;
 
-CUDAPolisher::CUDAPolisher(std::unique_ptr<bioparser::Parser<Sequence>> sparser,
-    std::unique_ptr<bioparser::Parser<Overlap>> oparser,
-    std::unique_ptr<bioparser::Parser<Sequence>> tparser,
+CUDAPolisher::CUDAPolisher(std::unique_ptr<Source<Sequence>> sparser,
+    std::unique_ptr<Source<Overlap>> oparser,
+    std::unique_ptr<Source<Sequence>> tparser,
     PolisherType type, uint32_t window_length, double quality_threshold,
     double error_threshold, bool trim, int8_t match, int8_t mismatch, int8_t gap,
     uint32_t num_threads, uint32_t cudapoa_batches, bool cuda_banded_alignment,
-    uint32_t cudaaligner_batches, uint32_t cudaaligner_band_width)
+    uint32_t cudaaligner_batches, uint32_t cudaaligner_band_width,
+    const std::string& regions_path, std::unique_ptr<Checkpoint> checkpoint,
+    uint32_t shard_id, uint32_t num_shards, uint64_t batch_size,
+    uint64_t max_memory)
         : Polisher(std::move(sparser), std::move(oparser), std::move(tparser),
                 type, window_length, quality_threshold, error_threshold, trim,
-                match, mismatch, gap, num_threads)
+                match, mismatch, gap, num_threads, regions_path,
+                std::move(checkpoint), shard_id, num_shards, batch_size,
+                max_memory)
         , cudapoa_batches_(cudapoa_batches)
         , cudaaligner_batches_(cudaaligner_batches)
         , gap_(gap)
@@ -73,7 +79,7 @@ CUDAPolisher::~CUDAPolisher()
 
 void CUDAPolisher::find_overlap_breaking_points(std::vector<std::unique_ptr<Overlap>>& overlaps)
 {
-    if (cudaaligner_batches_ >= 1)
+    if (cudaaligner_batches_ >= 1 && !overlaps.empty())
     {
         logger_->log();
         std::mutex mutex_overlaps;
@@ -116,11 +122,13 @@ void CUDAPolisher::find_overlap_breaking_points(std::vector<std::unique_ptr<Over
                 if (batch->hasOverlaps())
                 {
                     // Launch workload.
+                    uint64_t begin = tracer_->now();
                     batch->alignAll();
 
                     // Generate CIGAR strings for successful alignments. The actual breaking points
                     // will be calculate by the overlap object.
                     batch->generate_cigar_strings();
+                    tracer_->record("cudaaligner_batch", begin);
 
                     // logging bar
                     {
@@ -240,18 +248,39 @@ void CUDAPolisher::polish(std::vector<std::unique_ptr<Sequence>>& dst,
         }
 
         logger_->log("[racon::CUDAPolisher::polish] allocated memory on GPUs for polishing");
+        start_phase("generate_consensus");
 
         // Mutex for accessing the vector of windows.
         std::mutex mutex_windows;
 
         // Initialize window consensus statuses.
-        window_consensus_status_.resize(windows_.size(), false);
+        window_consensus_status_.assign(windows_.size(), false);
+
+        // Windows persisted in the checkpoint were left without layers,
+        // restore their consensus and queue only the remaining ones.
+        std::vector<bool> is_restored(windows_.size(), false);
+        std::vector<uint64_t> window_ids;
+        for (uint64_t i = 0; i < windows_.size(); ++i)
+        {
+            if (checkpoint_ != nullptr)
+            {
+                bool is_polished = false;
+                if (checkpoint_->restore(sequences_[windows_[i]->id()]->name(),
+                    *windows_[i], is_polished))
+                {
+                    window_consensus_status_.at(i) = is_polished;
+                    is_restored.at(i) = true;
+                    continue;
+                }
+            }
+            window_ids.emplace_back(i);
+        }
 
         // Index of next window to be added to a batch.
         uint32_t next_window_index = 0;
 
         // Lambda function for adding windows to batches.
-        auto fill_next_batch = [&mutex_windows, &next_window_index, this](CUDABatchProcessor* batch) -> std::pair<uint32_t, uint32_t> {
+        auto fill_next_batch = [&mutex_windows, &next_window_index, &window_ids, this](CUDABatchProcessor* batch) -> std::pair<uint32_t, uint32_t> {
             batch->reset();
 
             // Use mutex to read the vector containing windows in a threadsafe manner.
@@ -259,10 +288,10 @@ void CUDAPolisher::polish(std::vector<std::unique_ptr<Sequence>>& dst,
 
             // TODO: Reducing window wize by 10 for debugging.
             uint32_t initial_count = next_window_index;
-            uint32_t count = windows_.size();
+            uint32_t count = window_ids.size();
             while(next_window_index < count)
             {
-                if (batch->addWindow(windows_.at(next_window_index)))
+                if (batch->addWindow(windows_.at(window_ids.at(next_window_index))))
                 {
                     next_window_index++;
                 }
@@ -276,21 +305,23 @@ void CUDAPolisher::polish(std::vector<std::unique_ptr<Sequence>>& dst,
         };
 
         // Variables for keeping track of logger progress bar.
-        uint32_t logger_step = windows_.size() / RACON_LOGGER_BIN_SIZE;
+        uint32_t logger_step = window_ids.size() / RACON_LOGGER_BIN_SIZE;
         int32_t log_bar_idx = 0, log_bar_idx_prev = -1;
         uint32_t window_idx = 0;
         std::mutex mutex_log_bar_idx;
         logger_->log();
 
         // Lambda function for processing each batch.
-        auto process_batch = [&fill_next_batch, &logger_step, &log_bar_idx, &mutex_log_bar_idx, &window_idx, &log_bar_idx_prev, this](CUDABatchProcessor* batch) -> void {
+        auto process_batch = [&fill_next_batch, &window_ids, &logger_step, &log_bar_idx, &mutex_log_bar_idx, &window_idx, &log_bar_idx_prev, this](CUDABatchProcessor* batch) -> void {
             while(true)
             {
                 std::pair<uint32_t, uint32_t> range = fill_next_batch(batch);
                 if (batch->hasWindows())
                 {
                     // Launch workload.
+                    uint64_t begin = tracer_->now();
                     const std::vector<bool>& results = batch->generateConsensus();
+                    tracer_->record("cudapoa_batch", begin);
 
                     // Check if the number of batches processed is same as the range of
                     // of windows that were added.
@@ -304,7 +335,7 @@ void CUDAPolisher::polish(std::vector<std::unique_ptr<Sequence>>& dst,
                     // result vector of the CUDAPolisher.
                     for(uint32_t i = 0; i < results.size(); i++)
                     {
-                        window_consensus_status_.at(range.first + i) = results.at(i);
+                        window_consensus_status_.at(window_ids.at(range.first + i)) = results.at(i);
                     }
 
                     // logging bar
@@ -354,9 +385,12 @@ void CUDAPolisher::polish(std::vector<std::unique_ptr<Sequence>>& dst,
         // Start timing CPU time for failed windows on GPU
         logger_->log();
         // Process each failed windows in parallel on CPU
+        if (!windows_.empty()) {
+            create_consensus_backends(windows_.front()->type());
+        }
         std::vector<std::future<bool>> thread_failed_windows;
         for (uint64_t i = 0; i < windows_.size(); ++i) {
-            if (window_consensus_status_.at(i) == false)
+            if (window_consensus_status_.at(i) == false && !is_restored.at(i))
             {
                 thread_failed_windows.emplace_back(thread_pool_->submit(
                             [&](uint64_t j) -> bool {
@@ -366,8 +400,13 @@ void CUDAPolisher::polish(std::vector<std::unique_ptr<Sequence>>& dst,
                                     "thread identifier not present!\n");
                             exit(1);
                             }
-                            return window_consensus_status_.at(j) = windows_[j]->generate_consensus(
-                                    alignment_engines_[it->second], trim_);
+                            uint64_t begin = tracer_->now();
+                            std::vector<bool> status;
+                            consensus_backends_[it->second]->generate_consensus(
+                                    {windows_[j]}, status);
+                            window_consensus_status_.at(j) = status.front();
+                            tracer_->record("window_consensus", begin);
+                            return window_consensus_status_.at(j);
                             }, i));
             }
         }
@@ -381,34 +420,26 @@ void CUDAPolisher::polish(std::vector<std::unique_ptr<Sequence>>& dst,
             logger_->log("[racon::CUDAPolisher::polish] polished remaining windows on CPU");
             logger_->log();
         }
+        report_throughput();
 
-        // Collect results from all windows into final output.
-        std::string polished_data = "";
-        uint32_t num_polished_windows = 0;
-
-        for (uint64_t i = 0; i < windows_.size(); ++i) {
-
-            num_polished_windows += window_consensus_status_.at(i) == true ? 1 : 0;
-            polished_data += windows_[i]->consensus();
+        // Persist the newly generated consensus.
+        if (checkpoint_ != nullptr)
+        {
+            for (const auto& i : window_ids)
+            {
+                checkpoint_->store(sequences_[windows_[i]->id()]->name(),
+                    *windows_[i], window_consensus_status_.at(i));
+            }
+        }
 
-            if (i == windows_.size() - 1 || windows_[i + 1]->rank() == 0) {
-                double polished_ratio = num_polished_windows /
-                    static_cast<double>(windows_[i]->rank() + 1);
+        stop_phase("generate_consensus");
 
-                if (!drop_unpolished_sequences || polished_ratio > 0) {
-                    std::string tags = type_ == PolisherType::kF ? "r" : "";
-                    tags += " LN:i:" + std::to_string(polished_data.size());
-                    tags += " RC:i:" + std::to_string(targets_coverages_[windows_[i]->id()]);
-                    tags += " XC:f:" + std::to_string(polished_ratio);
-                    dst.emplace_back(createSequence(sequences_[windows_[i]->id()]->name() +
-                                tags, polished_data));
-                }
+        // Collect results from all windows into final output.
+        collect_polished_sequences(dst, drop_unpolished_sequences,
+            window_consensus_status_);
 
-                num_polished_windows = 0;
-                polished_data.clear();
-            }
-            windows_[i].reset();
-        }
+        std::vector<std::shared_ptr<Window>>().swap(windows_);
+        release_sequences();
 
         logger_->log("[racon::CUDAPolisher::polish] generated consensus");
 
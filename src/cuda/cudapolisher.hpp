@@ -28,16 +28,22 @@ public:
         PolisherType type, uint32_t window_length, double quality_threshold,
         double error_threshold, bool trim, int8_t match, int8_t mismatch, int8_t gap,
         uint32_t num_threads, uint32_t cudapoa_batches, bool cuda_banded_alignment,
-        uint32_t cudaaligner_batches, uint32_t cudaaligner_band_width);
+        uint32_t cudaaligner_batches, uint32_t cudaaligner_band_width,
+        const std::string& regions_path, const std::string& checkpoint_directory,
+        uint32_t shard_id, uint32_t num_shards, uint64_t batch_size,
+        uint64_t max_memory);
 
 protected:
-    CUDAPolisher(std::unique_ptr<bioparser::Parser<Sequence>> sparser,
-        std::unique_ptr<bioparser::Parser<Overlap>> oparser,
-        std::unique_ptr<bioparser::Parser<Sequence>> tparser,
+    CUDAPolisher(std::unique_ptr<Source<Sequence>> sparser,
+        std::unique_ptr<Source<Overlap>> oparser,
+        std::unique_ptr<Source<Sequence>> tparser,
         PolisherType type, uint32_t window_length, double quality_threshold,
         double error_threshold, bool trim, int8_t match, int8_t mismatch, int8_t gap,
         uint32_t num_threads, uint32_t cudapoa_batches, bool cuda_banded_alignment,
-        uint32_t cudaaligner_batches, uint32_t cudaaligner_band_width);
+        uint32_t cudaaligner_batches, uint32_t cudaaligner_band_width,
+        const std::string& regions_path, std::unique_ptr<Checkpoint> checkpoint,
+        uint32_t shard_id, uint32_t num_shards, uint64_t batch_size,
+        uint64_t max_memory);
     CUDAPolisher(const CUDAPolisher&) = delete;
     const CUDAPolisher& operator=(const CUDAPolisher&) = delete;
     virtual void find_overlap_breaking_points(std::vector<std::unique_ptr<Overlap>>& overlaps) override;
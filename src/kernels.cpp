@@ -0,0 +1,138 @@
+/*!
+ * @file kernels.cpp
+ *
+ * @brief Kernels source file, compiled once for each instruction set into
+ * namespace RACON_KERNELS_ISA (the portable build, which also selects the
+ * kernels, if undefined)
+ */
+
+#include "kernels.hpp"
+
+#ifndef RACON_KERNELS_ISA
+#define RACON_KERNELS_ISA portable
+#define RACON_KERNELS_SELECT
+#endif
+
+#define RACON_STRINGIFY(x) #x
+#define RACON_TO_STRING(x) RACON_STRINGIFY(x)
+
+namespace racon {
+
+namespace RACON_KERNELS_ISA {
+
+constexpr int32_t kNegativeInfinity = -(1 << 30);
+
+// helpers have internal linkage and std templates are not used, otherwise the
+// linker could pick a copy compiled for another instruction set
+
+static inline void lanesBroadcast(Lanes& dst, int32_t value) {
+    for (uint32_t k = 0; k < kNumLanes; ++k) {
+        dst[k] = value;
+    }
+}
+
+static inline void lanesMax(Lanes& dst, const Lanes& src) {
+    Lanes mask = src > dst;
+    dst = (src & mask) | (dst & ~mask);
+}
+
+static void lanesPredecessor(Lanes* row, const Lanes* predecessor_row,
+    const Lanes* sequences, const Lanes* base, const Lanes* mask,
+    int32_t match, int32_t mismatch, int32_t gap, uint32_t num_columns) {
+
+    Lanes g, m, delta, negative_infinity;
+    lanesBroadcast(g, gap);
+    lanesBroadcast(m, mismatch);
+    lanesBroadcast(delta, match - mismatch);
+    lanesBroadcast(negative_infinity, kNegativeInfinity);
+
+    Lanes h = ((predecessor_row[0] + g) & *mask) | (negative_infinity & ~*mask);
+    lanesMax(row[0], h);
+    for (uint32_t j = 1; j < num_columns; ++j) {
+        h = predecessor_row[j - 1] + m + ((sequences[j] == *base) & delta);
+        Lanes u = predecessor_row[j] + g;
+        lanesMax(h, u);
+        h = (h & *mask) | (negative_infinity & ~*mask);
+        lanesMax(row[j], h);
+    }
+}
+
+static void lanesInsertions(Lanes* row, int32_t gap, uint32_t num_columns) {
+    Lanes g;
+    lanesBroadcast(g, gap);
+    for (uint32_t j = 1; j < num_columns; ++j) {
+        Lanes h = row[j - 1] + g;
+        lanesMax(row[j], h);
+    }
+}
+
+static void bandedPredecessor(int32_t* row, const int32_t* predecessor,
+    const int32_t* profile, int32_t gap, uint32_t first, uint32_t last,
+    uint32_t predecessor_first, uint32_t predecessor_last) {
+
+    // deletions
+    uint32_t j = first > predecessor_first ? first : predecessor_first;
+    uint32_t k = last < predecessor_last ? last : predecessor_last;
+    for (; j <= k; ++j) {
+        int32_t h = predecessor[j] + gap;
+        row[j] = h > row[j] ? h : row[j];
+    }
+
+    // matches and mismatches
+    j = first > predecessor_first + 1 ? first : predecessor_first + 1;
+    k = last < predecessor_last + 1 ? last : predecessor_last + 1;
+    for (; j <= k; ++j) {
+        int32_t h = predecessor[j - 1] + profile[j];
+        row[j] = h > row[j] ? h : row[j];
+    }
+}
+
+static void bandedInsertions(int32_t* row, int32_t gap, uint32_t first,
+    uint32_t last) {
+
+    for (uint32_t j = first + 1; j <= last; ++j) {
+        int32_t h = row[j - 1] + gap;
+        row[j] = h > row[j] ? h : row[j];
+    }
+}
+
+const Kernels& kernels() {
+    static const Kernels dst = {
+        RACON_TO_STRING(RACON_KERNELS_ISA),
+        lanesPredecessor,
+        lanesInsertions,
+        bandedPredecessor,
+        bandedInsertions
+    };
+    return dst;
+}
+
+}
+
+#ifdef RACON_KERNELS_SELECT
+
+#ifdef RACON_GENERATE_DISPATCH
+namespace sse41 {
+    const Kernels& kernels();
+}
+namespace avx2 {
+    const Kernels& kernels();
+}
+#endif
+
+const Kernels& selectKernels() {
+#if defined(RACON_GENERATE_DISPATCH) && (defined(__x86_64__) || defined(__i386__))
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return avx2::kernels();
+    }
+    if (__builtin_cpu_supports("sse4.1")) {
+        return sse41::kernels();
+    }
+#endif
+    return portable::kernels();
+}
+
+#endif
+
+}
@@ -0,0 +1,51 @@
+/*!
+ * @file kernels.hpp
+ *
+ * @brief Kernels header file
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+namespace racon {
+
+constexpr uint32_t kNumLanes = 8;
+
+// GCC and Clang vector extension, operations are done on all lanes at once
+typedef int32_t Lanes __attribute__((vector_size(kNumLanes * sizeof(int32_t)),
+    __may_alias__));
+
+/*!
+ * @brief Inner loops of the dynamic programming engines, kernels.cpp is
+ * compiled once for each supported instruction set and engines pick the
+ * best one for the CPU on creation (vectors are passed by pointer only, which
+ * keeps the ABI independent of the instruction set)
+ */
+struct Kernels {
+    // instruction set the kernels were compiled for
+    const char* name;
+
+    // CPUBatchProcessor, updates columns [0, num_columns) of row with the
+    // lanes of the predecessor row selected by mask
+    void (*lanes_predecessor)(Lanes* row, const Lanes* predecessor_row,
+        const Lanes* sequences, const Lanes* base, const Lanes* mask,
+        int32_t match, int32_t mismatch, int32_t gap, uint32_t num_columns);
+    void (*lanes_insertions)(Lanes* row, int32_t gap, uint32_t num_columns);
+
+    // BandedAlignmentEngine, rows are indexed by columns, row stores cells
+    // [first, last] and predecessor cells [predecessor_first, predecessor_last]
+    void (*banded_predecessor)(int32_t* row, const int32_t* predecessor,
+        const int32_t* profile, int32_t gap, uint32_t first, uint32_t last,
+        uint32_t predecessor_first, uint32_t predecessor_last);
+    void (*banded_insertions)(int32_t* row, int32_t gap, uint32_t first,
+        uint32_t last);
+};
+
+/*!
+ * @brief Returns the kernels of the best instruction set supported by the CPU
+ * (variants other than the portable one are built with racon_generate_dispatch)
+ */
+const Kernels& selectKernels();
+
+}
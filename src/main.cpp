@@ -4,10 +4,14 @@
 #include <getopt.h>
 
 #include <string>
+#include <utility>
 #include <vector>
 
 #include "sequence.hpp"
+#include "window.hpp"
 #include "polisher.hpp"
+#include "server.hpp"
+#include "writer.hpp"
 #ifdef CUDA_ENABLED
 #include "cuda/cudapolisher.hpp"
 #endif
@@ -19,18 +23,55 @@
 static const char* version = RACON_VERSION;
 static const int32_t CUDAALIGNER_INPUT_CODE = 10000;
 static const int32_t CUDAALIGNER_BAND_WIDTH_INPUT_CODE = 10001;
+static const int32_t REGIONS_INPUT_CODE = 10002;
+static const int32_t CHECKPOINT_INPUT_CODE = 10003;
+static const int32_t SHARD_INPUT_CODE = 10004;
+static const int32_t BATCH_SIZE_INPUT_CODE = 10005;
+static const int32_t SERVER_INPUT_CODE = 10006;
+static const int32_t METRICS_INPUT_CODE = 10007;
+static const int32_t TRACE_INPUT_CODE = 10008;
+static const int32_t MAX_MEMORY_INPUT_CODE = 10009;
+static const int32_t NUMA_INPUT_CODE = 10010;
+static const int32_t BAND_WIDTH_INPUT_CODE = 10011;
+static const int32_t CPU_BATCHES_INPUT_CODE = 10012;
+static const int32_t CPU_ALIGNER_INPUT_CODE = 10013;
+static const int32_t CONSENSUS_BACKEND_INPUT_CODE = 10014;
+static const int32_t ALIGNER_BACKEND_INPUT_CODE = 10015;
+static const int32_t PREFETCH_INPUT_CODE = 10016;
+static const int32_t INDEX_INPUT_CODE = 10017;
+static const int32_t QUALITY_PREFILTER_INPUT_CODE = 10018;
+static const int32_t MAX_COVERAGE_INPUT_CODE = 10019;
 
 static struct option options[] = {
     {"include-unpolished", no_argument, 0, 'u'},
     {"fragment-correction", no_argument, 0, 'f'},
     {"window-length", required_argument, 0, 'w'},
     {"quality-threshold", required_argument, 0, 'q'},
+    {"quality-prefilter", no_argument, 0, QUALITY_PREFILTER_INPUT_CODE},
     {"error-threshold", required_argument, 0, 'e'},
+    {"max-coverage", required_argument, 0, MAX_COVERAGE_INPUT_CODE},
     {"no-trimming", no_argument, 0, 'T'},
     {"match", required_argument, 0, 'm'},
     {"mismatch", required_argument, 0, 'x'},
     {"gap", required_argument, 0, 'g'},
     {"threads", required_argument, 0, 't'},
+    {"output", required_argument, 0, 'o'},
+    {"index", no_argument, 0, INDEX_INPUT_CODE},
+    {"band-width", required_argument, 0, BAND_WIDTH_INPUT_CODE},
+    {"cpu-batches", no_argument, 0, CPU_BATCHES_INPUT_CODE},
+    {"cpu-aligner-batches", no_argument, 0, CPU_ALIGNER_INPUT_CODE},
+    {"consensus-backend", required_argument, 0, CONSENSUS_BACKEND_INPUT_CODE},
+    {"aligner-backend", required_argument, 0, ALIGNER_BACKEND_INPUT_CODE},
+    {"regions", required_argument, 0, REGIONS_INPUT_CODE},
+    {"checkpoint", required_argument, 0, CHECKPOINT_INPUT_CODE},
+    {"shard", required_argument, 0, SHARD_INPUT_CODE},
+    {"batch-size", required_argument, 0, BATCH_SIZE_INPUT_CODE},
+    {"max-memory", required_argument, 0, MAX_MEMORY_INPUT_CODE},
+    {"prefetch", required_argument, 0, PREFETCH_INPUT_CODE},
+    {"numa", no_argument, 0, NUMA_INPUT_CODE},
+    {"server", required_argument, 0, SERVER_INPUT_CODE},
+    {"metrics", required_argument, 0, METRICS_INPUT_CODE},
+    {"trace", required_argument, 0, TRACE_INPUT_CODE},
     {"version", no_argument, 0, 'v'},
     {"help", no_argument, 0, 'h'},
 #ifdef CUDA_ENABLED
@@ -47,10 +88,25 @@ void help();
 int main(int argc, char** argv) {
 
     std::vector<std::string> input_paths;
+    std::string regions_path = "";
+    std::string checkpoint_directory = "";
+    std::string socket_path = "";
+    std::string metrics_path = "";
+    std::string trace_path = "";
+    std::string output_path = "";
+    bool index = false;
+    bool numa = false;
+    uint32_t band_width = 0;
+    bool cpu_batches = false;
+    bool cpu_aligner = false;
+    std::vector<std::pair<racon::WindowType, std::string>> consensus_backends;
+    std::string aligner_backend = "";
 
     uint32_t window_length = 500;
     double quality_threshold = 10.0;
+    bool quality_prefilter = false;
     double error_threshold = 0.3;
+    uint32_t max_coverage = 0;
     bool trim = true;
 
     int8_t match = 3;
@@ -60,13 +116,18 @@ int main(int argc, char** argv) {
 
     bool drop_unpolished_sequences = true;
     uint32_t num_threads = 1;
+    uint32_t shard_id = 0;
+    uint32_t num_shards = 1;
+    uint64_t batch_size = 0;
+    uint64_t max_memory = 0;
+    uint64_t prefetch = 0;
 
     uint32_t cudapoa_batches = 0;
     uint32_t cudaaligner_batches = 0;
     uint32_t cudaaligner_band_width = 0;
     bool cuda_banded_alignment = false;
 
-    std::string optstring = "ufw:q:e:m:x:g:t:h";
+    std::string optstring = "ufw:q:e:m:x:g:t:o:h";
 #ifdef CUDA_ENABLED
     optstring += "bc::";
 #endif
@@ -86,9 +147,15 @@ int main(int argc, char** argv) {
             case 'q':
                 quality_threshold = atof(optarg);
                 break;
+            case QUALITY_PREFILTER_INPUT_CODE:
+                quality_prefilter = true;
+                break;
             case 'e':
                 error_threshold = atof(optarg);
                 break;
+            case MAX_COVERAGE_INPUT_CODE:
+                max_coverage = atoi(optarg);
+                break;
             case 'T':
                 trim = false;
                 break;
@@ -104,6 +171,73 @@ int main(int argc, char** argv) {
             case 't':
                 num_threads = atoi(optarg);
                 break;
+            case 'o':
+                output_path = optarg;
+                break;
+            case INDEX_INPUT_CODE:
+                index = true;
+                break;
+            case REGIONS_INPUT_CODE:
+                regions_path = optarg;
+                break;
+            case CHECKPOINT_INPUT_CODE:
+                checkpoint_directory = optarg;
+                break;
+            case SHARD_INPUT_CODE:
+                if (sscanf(optarg, "%u/%u", &shard_id, &num_shards) != 2 ||
+                    shard_id == 0 || shard_id > num_shards) {
+                    fprintf(stderr, "[racon::] error: invalid shard %s!\n", optarg);
+                    exit(1);
+                }
+                --shard_id;
+                break;
+            case BATCH_SIZE_INPUT_CODE:
+                batch_size = atoll(optarg);
+                break;
+            case MAX_MEMORY_INPUT_CODE:
+                max_memory = atof(optarg) * 1024 * 1024 * 1024;
+                break;
+            case PREFETCH_INPUT_CODE:
+                prefetch = atof(optarg) * 1024 * 1024;
+                break;
+            case BAND_WIDTH_INPUT_CODE:
+                band_width = atoi(optarg);
+                break;
+            case CPU_BATCHES_INPUT_CODE:
+                cpu_batches = true;
+                break;
+            case CPU_ALIGNER_INPUT_CODE:
+                cpu_aligner = true;
+                break;
+            case CONSENSUS_BACKEND_INPUT_CODE: {
+                std::string backend = optarg;
+                if (backend.compare(0, 4, "ngs=") == 0) {
+                    consensus_backends.emplace_back(racon::WindowType::kNGS,
+                        backend.substr(4));
+                } else if (backend.compare(0, 4, "tgs=") == 0) {
+                    consensus_backends.emplace_back(racon::WindowType::kTGS,
+                        backend.substr(4));
+                } else {
+                    consensus_backends.emplace_back(racon::WindowType::kNGS, backend);
+                    consensus_backends.emplace_back(racon::WindowType::kTGS, backend);
+                }
+                break;
+            }
+            case ALIGNER_BACKEND_INPUT_CODE:
+                aligner_backend = optarg;
+                break;
+            case NUMA_INPUT_CODE:
+                numa = true;
+                break;
+            case SERVER_INPUT_CODE:
+                socket_path = optarg;
+                break;
+            case METRICS_INPUT_CODE:
+                metrics_path = optarg;
+                break;
+            case TRACE_INPUT_CODE:
+                trace_path = optarg;
+                break;
             case 'v':
                 printf("%s\n", version);
                 exit(0);
@@ -149,20 +283,104 @@ int main(int argc, char** argv) {
         exit(1);
     }
 
+    // jobs of the server are polished whole, without checkpoints
+    if (!socket_path.empty() && (!checkpoint_directory.empty() ||
+        !regions_path.empty() || num_shards > 1)) {
+        fprintf(stderr, "[racon::] error: options --checkpoint, --regions and "
+            "--shard are not supported with option --server!\n");
+        exit(1);
+    }
+
     auto polisher = racon::createPolisher(input_paths[0], input_paths[1],
         input_paths[2], type == 0 ? racon::PolisherType::kC :
         racon::PolisherType::kF, window_length, quality_threshold,
         error_threshold, trim, match, mismatch, gap, num_threads,
         cudapoa_batches, cuda_banded_alignment, cudaaligner_batches,
-        cudaaligner_band_width);
+        cudaaligner_band_width, regions_path, checkpoint_directory, shard_id,
+        num_shards, batch_size, max_memory);
+
+    if (numa) {
+        polisher->enable_numa();
+    }
 
-    polisher->initialize();
+    if (prefetch != 0) {
+        polisher->enable_prefetch(prefetch);
+    }
 
-    std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
-    polisher->polish(polished_sequences, drop_unpolished_sequences);
+    if (quality_prefilter) {
+        polisher->enable_quality_prefilter();
+    }
+
+    if (max_coverage != 0) {
+        polisher->set_max_coverage(max_coverage);
+    }
 
-    for (const auto& it: polished_sequences) {
-        fprintf(stdout, ">%s\n%s\n", it->name().c_str(), it->data().c_str());
+    if (band_width != 0) {
+        polisher->enable_banded_alignment(band_width);
+    }
+
+    if (cpu_batches) {
+        polisher->enable_cpu_batches();
+    }
+
+    if (cpu_aligner) {
+        polisher->enable_cpu_aligner();
+    }
+
+    for (const auto& it: consensus_backends) {
+        polisher->set_consensus_backend(it.first, it.second);
+    }
+
+    if (!aligner_backend.empty()) {
+        polisher->set_aligner_backend(aligner_backend);
+    }
+
+    if (!metrics_path.empty()) {
+        polisher->enable_metrics();
+    }
+
+    if (!trace_path.empty()) {
+        polisher->enable_tracing();
+    }
+
+    if (!socket_path.empty()) {
+        polisher->preload_sequences();
+    }
+
+    if (index && output_path.empty()) {
+        fprintf(stderr, "[racon::] warning: option --index requires option "
+            "--output, ignoring index!\n");
+    }
+
+    if (!output_path.empty()) {
+        auto writer = racon::createWriter(output_path, index, num_threads);
+        polisher->run([&](std::unique_ptr<racon::Sequence> sequence) -> void {
+            writer->write(*sequence);
+        }, drop_unpolished_sequences);
+        writer->close();
+    } else {
+        polisher->run([](std::unique_ptr<racon::Sequence> sequence) -> void {
+            fprintf(stdout, ">%s\n%s\n", sequence->name().c_str(),
+                sequence->data().c_str());
+        }, drop_unpolished_sequences);
+        fflush(stdout);
+    }
+
+    if (!metrics_path.empty() && !polisher->metrics().write(metrics_path)) {
+        fprintf(stderr, "[racon::] error: unable to write metrics to %s!\n",
+            metrics_path.c_str());
+        exit(1);
+    }
+    if (!trace_path.empty() && !polisher->tracer().write(trace_path)) {
+        fprintf(stderr, "[racon::] error: unable to write trace to %s!\n",
+            trace_path.c_str());
+        exit(1);
+    }
+
+    if (!socket_path.empty()) {
+        auto server = racon::createServer(socket_path, std::move(polisher),
+            drop_unpolished_sequences);
+        server->run();
     }
 
     return 0;
@@ -195,9 +413,18 @@ void help() {
         "        -q, --quality-threshold <float>\n"
         "            default: 10.0\n"
         "            threshold for average base quality of windows used in POA\n"
+        "        --quality-prefilter\n"
+        "            skips alignment of overlaps whose segments are estimated\n"
+        "            (from base qualities of the query) to fall below the\n"
+        "            quality threshold\n"
         "        -e, --error-threshold <float>\n"
         "            default: 0.3\n"
         "            maximum allowed error rate used for filtering overlaps\n"
+        "        --max-coverage <int>\n"
+        "            default: 0\n"
+        "            maximal number of overlaps aligned to each window, the\n"
+        "            best ones (by identity, length and mapping quality) are\n"
+        "            kept (0 disables the cap)\n"
         "        --no-trimming\n"
         "            disables consensus trimming at window ends\n"
         "        -m, --match <int>\n"
@@ -212,6 +439,103 @@ void help() {
         "        -t, --threads <int>\n"
         "            default: 1\n"
         "            number of threads\n"
+        "        -o, --output <file>\n"
+        "            writes polished sequences to the given file instead of\n"
+        "            stdout, paths ending with .gz are compressed in BGZF\n"
+        "            blocks on all threads (readable by gzip and bgzip); writing\n"
+        "            is a serial stage after each batch, it does not overlap\n"
+        "            with consensus\n"
+        "        --index\n"
+        "            with --output, creates the FASTA index (.fai) and, for\n"
+        "            compressed output, the BGZF index (.gzi)\n"
+        "        --band-width <int>\n"
+        "            default: 0\n"
+        "            restricts partial order alignment on the CPU to a band of\n"
+        "            the given width on each side of the expected diagonal (0\n"
+        "            disables banding), layers whose alignment reaches the edge\n"
+        "            of the band are realigned without it\n"
+        "        --cpu-batches\n"
+        "            generates consensus of several windows at once per thread\n"
+        "            by aligning their layers in separate SIMD lanes (faster for\n"
+        "            short windows, ignores --band-width)\n"
+        "        --cpu-aligner-batches\n"
+        "            aligns several overlaps at once per thread by placing them\n"
+        "            in separate SIMD lanes of an alignment banded by the error\n"
+        "            threshold (-e), overlaps which do not fit into the band are\n"
+        "            aligned with edlib (their number is reported in --metrics)\n"
+        "        --consensus-backend [ngs=|tgs=]<name>\n"
+        "            default: spoa\n"
+        "            engine which generates consensus of windows of short (ngs)\n"
+        "            or long (tgs) reads, or both if no type is given (can be\n"
+        "            repeated); one of spoa, banded (uses --band-width), batch\n"
+        "            (same as --cpu-batches) and pileup (majority vote for\n"
+        "            accurate reads, windows with indels are polished entirely\n"
+        "            by spoa), overrides the options above\n"
+        "        --aligner-backend <name>\n"
+        "            default: edlib\n"
+        "            engine which aligns overlaps; one of edlib and batch (same\n"
+        "            as --cpu-aligner-batches)\n"
+        "        --regions <file>\n"
+        "            input file in BED format (can be compressed with gzip)\n"
+        "            containing regions of target sequences which will be\n"
+        "            polished (the remaining sequence is left unchanged,\n"
+        "            target sequences without regions are output unchanged and\n"
+        "            XC counts only windows within regions)\n"
+        "        --checkpoint <directory>\n"
+        "            persists consensus of polished windows to the given\n"
+        "            directory and restores them on restart (input files and\n"
+        "            parameters have to be the same)\n"
+        "        --shard <int>/<int>\n"
+        "            polishes only the i-th of N deterministic partitions of\n"
+        "            target sequences (1-based), output sequences are tagged\n"
+        "            with their target index (TI) and can be merged with\n"
+        "            racon_merge (which fails on missing indices unless it is\n"
+        "            given --allow-gaps, as needed for shards run without -u)\n"
+        "        --batch-size <int>\n"
+        "            default: 0\n"
+        "            total length of target sequences which are loaded and\n"
+        "            polished at once (0 loads all), only sequences overlapping\n"
+        "            them are kept in memory and polished sequences are output\n"
+        "            after each batch; each batch parses the whole sequences\n"
+        "            and overlaps files again (--prefetch overlaps this with\n"
+        "            polishing)\n"
+        "        --max-memory <float>\n"
+        "            memory budget in gigabytes, if the projected footprint of\n"
+        "            the input exceeds it, target sequences are polished in\n"
+        "            batches sized to fit the budget (see --batch-size)\n"
+        "        --prefetch <float>\n"
+        "            default: 0\n"
+        "            megabytes of sequences, overlaps and target sequences\n"
+        "            which are parsed ahead on separate I/O threads (0\n"
+        "            disables prefetching), with --batch-size the next batch\n"
+        "            is read while the current one is polished\n"
+        "        --numa\n"
+        "            pins worker threads to NUMA nodes, so that their alignment\n"
+        "            workspaces are allocated on their own node, and polishes\n"
+        "            windows of each target sequence with workers of a single\n"
+        "            node (sequences and windows are not moved between nodes)\n"
+        "        --server <file>\n"
+        "            after polishing the input files, keeps sequences in memory\n"
+        "            and polishes further jobs received over the given Unix\n"
+        "            socket (each job is a line with paths to overlaps and\n"
+        "            target sequences separated by a tab, polished sequences\n"
+        "            are sent back; a line 'shutdown' stops the server), the\n"
+        "            socket is accessible by the owner only and each job runs\n"
+        "            in a child process, so a failed job sends a line starting\n"
+        "            with 'error:' and leaves the server running (not supported\n"
+        "            with --checkpoint, --regions and --shard)\n"
+        "        --metrics <file>\n"
+        "            writes wall and CPU time and peak memory of each phase,\n"
+        "            overlap and window counters, throughput of each backend\n"
+        "            (items, bases and busy nanoseconds summed over threads) and a\n"
+        "            histogram of layers per window of the input files to the\n"
+        "            given file in JSON format (peak memory is reset before each\n"
+        "            phase through /proc/self/clear_refs)\n"
+        "        --trace <file>\n"
+        "            writes a timeline of thread pool tasks (overlap alignment,\n"
+        "            sequence transformation, window consensus) and phases of\n"
+        "            the input files to the given file in Chrome trace event\n"
+        "            format (viewable in chrome://tracing or Perfetto)\n"
         "        --version\n"
         "            prints the version number\n"
         "        -h, --help\n"
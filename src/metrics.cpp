@@ -0,0 +1,170 @@
+/*!
+ * @file metrics.cpp
+ *
+ * @brief Metrics source file
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <sys/resource.h>
+
+#include "metrics.hpp"
+
+namespace racon {
+
+static double cpuTime() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+        (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// peak resident set size since the last resetPeakRss(), falls back to the
+// lifetime peak if /proc is unavailable
+static uint64_t peakRss() {
+    FILE* file = fopen("/proc/self/status", "r");
+    if (file != nullptr) {
+        char line[256];
+        unsigned long value = 0;
+        bool is_found = false;
+        while (!is_found && fgets(line, sizeof(line), file) != nullptr) {
+            is_found = strncmp(line, "VmHWM:", 6) == 0 &&
+                sscanf(line + 6, "%lu", &value) == 1;
+        }
+        fclose(file);
+        if (is_found) {
+            return static_cast<uint64_t>(value) * 1024; // kB
+        }
+    }
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return static_cast<uint64_t>(usage.ru_maxrss) * 1024; // kB on Linux
+}
+
+// resets the peak resident set size to the current one (Linux >= 4.0)
+static void resetPeakRss() {
+    FILE* file = fopen("/proc/self/clear_refs", "w");
+    if (file != nullptr) {
+        fputs("5", file);
+        fclose(file);
+    }
+}
+
+static void writeString(FILE* file, const std::string& src) {
+    fputc('"', file);
+    for (const auto& it: src) {
+        if (it == '"' || it == '\\') {
+            fprintf(file, "\\%c", it);
+        } else if (static_cast<unsigned char>(it) < 0x20) {
+            fprintf(file, "\\u%04x", it);
+        } else {
+            fputc(it, file);
+        }
+    }
+    fputc('"', file);
+}
+
+Metrics::Metrics()
+        : phases_(), counters_(), layers_histogram_(), is_enabled_(false),
+        peak_rss_(0) {
+}
+
+Metrics::~Metrics() {
+}
+
+void Metrics::enable() {
+    is_enabled_ = true;
+}
+
+Metrics::Phase& Metrics::phase(const std::string& name) {
+    for (auto& it: phases_) {
+        if (it.first == name) {
+            return it.second;
+        }
+    }
+    phases_.emplace_back(name, Phase{0., 0., 0,
+        std::chrono::steady_clock::now(), cpuTime()});
+    return phases_.back().second;
+}
+
+void Metrics::start(const std::string& name) {
+    auto& it = phase(name);
+    it.wall_time_point = std::chrono::steady_clock::now();
+    it.cpu_time_point = cpuTime();
+    if (is_enabled_) {
+        peak_rss_ = std::max(peak_rss_, peakRss());
+        resetPeakRss();
+    }
+}
+
+void Metrics::stop(const std::string& name) {
+    auto& it = phase(name);
+    it.wall_time += std::chrono::duration_cast<std::chrono::duration<double>>(
+        std::chrono::steady_clock::now() - it.wall_time_point).count();
+    it.cpu_time += cpuTime() - it.cpu_time_point;
+    if (is_enabled_) {
+        it.peak_rss = std::max(it.peak_rss, peakRss());
+        peak_rss_ = std::max(peak_rss_, it.peak_rss);
+    }
+}
+
+void Metrics::add(const std::string& counter, uint64_t value) {
+    for (auto& it: counters_) {
+        if (it.first == counter) {
+            it.second += value;
+            return;
+        }
+    }
+    counters_.emplace_back(counter, value);
+}
+
+void Metrics::max(const std::string& counter, uint64_t value) {
+    for (auto& it: counters_) {
+        if (it.first == counter) {
+            it.second = std::max(it.second, value);
+            return;
+        }
+    }
+    counters_.emplace_back(counter, value);
+}
+
+void Metrics::add_window(uint32_t num_layers) {
+    ++layers_histogram_[num_layers];
+}
+
+bool Metrics::write(const std::string& path) const {
+
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    fprintf(file, "{\n  \"phases\": {");
+    for (uint32_t i = 0; i < phases_.size(); ++i) {
+        fprintf(file, "%s\n    ", i == 0 ? "" : ",");
+        writeString(file, phases_[i].first);
+        fprintf(file, ": {\"wall_time\": %.6f, \"cpu_time\": %.6f, "
+            "\"peak_rss\": %lu}", phases_[i].second.wall_time, phases_[i].second.cpu_time,
+            static_cast<unsigned long>(phases_[i].second.peak_rss));
+    }
+    fprintf(file, "\n  },\n  \"counters\": {");
+    for (uint32_t i = 0; i < counters_.size(); ++i) {
+        fprintf(file, "%s\n    ", i == 0 ? "" : ",");
+        writeString(file, counters_[i].first);
+        fprintf(file, ": %lu", static_cast<unsigned long>(counters_[i].second));
+    }
+    fprintf(file, "\n  },\n  \"layers_per_window\": [");
+    uint32_t i = 0;
+    for (const auto& it: layers_histogram_) {
+        fprintf(file, "%s\n    {\"layers\": %u, \"windows\": %lu}",
+            i++ == 0 ? "" : ",", it.first, static_cast<unsigned long>(it.second));
+    }
+    fprintf(file, "\n  ],\n  \"peak_rss\": %lu\n}\n",
+        static_cast<unsigned long>(std::max(peak_rss_, peakRss())));
+
+    fclose(file);
+    return true;
+}
+
+}
@@ -0,0 +1,88 @@
+/*!
+ * @file metrics.hpp
+ *
+ * @brief Metrics header file
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace racon {
+
+class Metrics {
+public:
+    Metrics();
+    ~Metrics();
+
+    /*!
+     * @brief Enables sampling of the peak resident set size around phases,
+     * which is reset through /proc/self/clear_refs
+     */
+    void enable();
+
+    bool is_enabled() const {
+        return is_enabled_;
+    }
+
+    /*!
+     * @brief Starts measuring wall and CPU time of a phase and resets the
+     * peak resident set size of the process if enabled (phases must not be
+     * nested)
+     */
+    void start(const std::string& phase);
+
+    /*!
+     * @brief Adds the wall and CPU time elapsed since start() to the phase
+     * and records the peak resident set size reached since start() if enabled
+     */
+    void stop(const std::string& phase);
+
+    /*!
+     * @brief Increases a counter by value
+     */
+    void add(const std::string& counter, uint64_t value);
+
+    /*!
+     * @brief Sets a counter to value if it is larger
+     */
+    void max(const std::string& counter, uint64_t value);
+
+    /*!
+     * @brief Adds a window with the given number of layers to the histogram
+     */
+    void add_window(uint32_t num_layers);
+
+    /*!
+     * @brief Writes all phases, counters and the histogram as JSON, returns
+     * false if the file can not be opened
+     */
+    bool write(const std::string& path) const;
+
+private:
+    struct Phase {
+        double wall_time;
+        double cpu_time;
+        uint64_t peak_rss;
+        std::chrono::time_point<std::chrono::steady_clock> wall_time_point;
+        double cpu_time_point;
+    };
+
+    Metrics(const Metrics&) = delete;
+    const Metrics& operator=(const Metrics&) = delete;
+
+    Phase& phase(const std::string& name);
+
+    std::vector<std::pair<std::string, Phase>> phases_;
+    std::vector<std::pair<std::string, uint64_t>> counters_;
+    std::map<uint32_t, uint64_t> layers_histogram_;
+    bool is_enabled_;
+    uint64_t peak_rss_;
+};
+
+}
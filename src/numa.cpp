@@ -0,0 +1,135 @@
+/*!
+ * @file numa.cpp
+ *
+ * @brief NUMA topology source file
+ */
+
+#include <dirent.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "numa.hpp"
+
+namespace racon {
+
+// parses lists of the form 0-3,8,10-11
+static std::vector<uint32_t> parseCpuList(const std::string& src) {
+
+    std::vector<uint32_t> dst;
+    for (uint32_t i = 0; i < src.size();) {
+        char* end = nullptr;
+        uint32_t begin = strtoul(&src[i], &end, 10);
+        if (end == &src[i]) {
+            break;
+        }
+        uint32_t last = begin;
+        i = end - src.c_str();
+        if (i < src.size() && src[i] == '-') {
+            last = strtoul(&src[i + 1], &end, 10);
+            i = end - src.c_str();
+        }
+        for (uint32_t j = begin; j <= last; ++j) {
+            dst.emplace_back(j);
+        }
+        if (i < src.size() && src[i] == ',') {
+            ++i;
+        } else {
+            break;
+        }
+    }
+    return dst;
+}
+
+std::vector<std::vector<uint32_t>> numaNodes(const std::string& path) {
+
+    std::vector<std::pair<uint32_t, std::vector<uint32_t>>> nodes;
+
+    DIR* directory = opendir(path.c_str());
+    if (directory == nullptr) {
+        return {};
+    }
+    struct dirent* entry;
+    while ((entry = readdir(directory)) != nullptr) {
+        uint32_t node_id;
+        char suffix;
+        if (sscanf(entry->d_name, "node%u%c", &node_id, &suffix) != 1) {
+            continue;
+        }
+
+        FILE* file = fopen((path + "/" + entry->d_name + "/cpulist").c_str(), "r");
+        if (file == nullptr) {
+            continue;
+        }
+        char buffer[4096];
+        std::string cpulist = fgets(buffer, sizeof(buffer), file) != nullptr ?
+            buffer : "";
+        fclose(file);
+
+        auto cpus = parseCpuList(cpulist);
+        if (!cpus.empty()) {
+            nodes.emplace_back(node_id, cpus);
+        }
+    }
+    closedir(directory);
+
+    std::sort(nodes.begin(), nodes.end());
+
+    std::vector<std::vector<uint32_t>> dst;
+    for (auto& it: nodes) {
+        dst.emplace_back(std::move(it.second));
+    }
+    return dst;
+}
+
+std::vector<uint32_t> assignWorkers(uint32_t num_workers, uint32_t num_nodes) {
+
+    std::vector<uint32_t> dst(num_workers);
+    for (uint32_t i = 0; i < num_workers; ++i) {
+        dst[i] = static_cast<uint64_t>(i) * num_nodes / num_workers;
+    }
+    return dst;
+}
+
+std::vector<std::vector<uint64_t>> assignRuns(const std::vector<uint64_t>& keys,
+    uint32_t num_nodes) {
+
+    std::vector<std::vector<uint64_t>> dst(num_nodes);
+    for (uint64_t i = 0, j = 0; i < keys.size(); i = j) {
+        while (j < keys.size() && keys[j] == keys[i]) {
+            ++j;
+        }
+        auto& it = *std::min_element(dst.begin(), dst.end(),
+            [] (const std::vector<uint64_t>& lhs, const std::vector<uint64_t>& rhs) -> bool {
+                return lhs.size() < rhs.size();
+            });
+        for (uint64_t k = i; k < j; ++k) {
+            it.emplace_back(k);
+        }
+    }
+    return dst;
+}
+
+bool pinThread(const std::vector<uint32_t>& cpus) {
+
+#if defined(__linux__)
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    for (const auto& it: cpus) {
+        if (it < CPU_SETSIZE) {
+            CPU_SET(it, &cpu_set);
+        }
+    }
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+#else
+    (void) cpus;
+    return false;
+#endif
+}
+
+}
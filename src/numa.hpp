@@ -0,0 +1,41 @@
+/*!
+ * @file numa.hpp
+ *
+ * @brief NUMA topology header file
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+namespace racon {
+
+/*!
+ * @brief Returns CPUs of each online NUMA node read from sysfs, or from a
+ * directory laid out like it (empty if the topology is not available)
+ */
+std::vector<std::vector<uint32_t>> numaNodes(
+    const std::string& path = "/sys/devices/system/node");
+
+/*!
+ * @brief Assigns consecutive workers to the same node so that all nodes get
+ * equal shares of workers
+ */
+std::vector<uint32_t> assignWorkers(uint32_t num_workers, uint32_t num_nodes);
+
+/*!
+ * @brief Distributes positions of keys among nodes, each run of equal
+ * consecutive keys goes whole to the node with the fewest positions
+ */
+std::vector<std::vector<uint64_t>> assignRuns(const std::vector<uint64_t>& keys,
+    uint32_t num_nodes);
+
+/*!
+ * @brief Restricts the calling thread to the given CPUs, returns false on
+ * failure
+ */
+bool pinThread(const std::vector<uint32_t>& cpus);
+
+}
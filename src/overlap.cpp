@@ -5,6 +5,7 @@
  */
 
 #include <algorithm>
+#include <limits>
 
 #include "sequence.hpp"
 #include "overlap.hpp"
@@ -12,13 +13,13 @@
 
 namespace racon {
 
-Overlap::Overlap(uint64_t a_id, uint64_t b_id, double, uint32_t,
+Overlap::Overlap(uint64_t a_id, uint64_t b_id, double error, uint32_t,
     uint32_t a_rc, uint32_t a_begin, uint32_t a_end, uint32_t a_length,
     uint32_t b_rc, uint32_t b_begin, uint32_t b_end, uint32_t b_length)
         : q_name_(), q_id_(a_id - 1), q_begin_(a_begin), q_end_(a_end),
         q_length_(a_length), t_name_(), t_id_(b_id - 1), t_begin_(b_begin),
         t_end_(b_end), t_length_(b_length), strand_(a_rc ^ b_rc), length_(),
-        error_(), cigar_(), is_valid_(true), is_transmuted_(false),
+        error_(), identity_(1 - error), mapping_quality_(0), cigar_(), is_valid_(true), is_transmuted_(false),
         breaking_points_() {
 
     length_ = std::max(q_end_ - q_begin_, t_end_ - t_begin_);
@@ -29,11 +30,14 @@ Overlap::Overlap(uint64_t a_id, uint64_t b_id, double, uint32_t,
 Overlap::Overlap(const char* q_name, uint32_t q_name_length, uint32_t q_length,
     uint32_t q_begin, uint32_t q_end, char orientation, const char* t_name,
     uint32_t t_name_length, uint32_t t_length, uint32_t t_begin,
-    uint32_t t_end, uint32_t, uint32_t, uint32_t)
+    uint32_t t_end, uint32_t matching_bases, uint32_t overlap_length,
+    uint32_t mapping_quality)
         : q_name_(q_name, q_name_length), q_id_(), q_begin_(q_begin),
         q_end_(q_end), q_length_(q_length), t_name_(t_name, t_name_length),
         t_id_(), t_begin_(t_begin), t_end_(t_end), t_length_(t_length),
-        strand_(orientation == '-'), length_(), error_(), cigar_(),
+        strand_(orientation == '-'), length_(), error_(), identity_(
+        overlap_length == 0 ? 0 : matching_bases / static_cast<double>(overlap_length)),
+        mapping_quality_(mapping_quality), cigar_(),
         is_valid_(true), is_transmuted_(false), breaking_points_() {
 
     length_ = std::max(q_end_ - q_begin_, t_end_ - t_begin_);
@@ -43,13 +47,14 @@ Overlap::Overlap(const char* q_name, uint32_t q_name_length, uint32_t q_length,
 
 Overlap::Overlap(const char* q_name, uint32_t q_name_length, uint32_t flag,
     const char* t_name, uint32_t t_name_length, uint32_t t_begin,
-    uint32_t, const char* cigar, uint32_t cigar_length, const char*,
+    uint32_t mapping_quality, const char* cigar, uint32_t cigar_length, const char*,
     uint32_t, uint32_t, uint32_t, const char*, uint32_t, const char*,
     uint32_t)
         : q_name_(q_name, q_name_length), q_id_(), q_begin_(0), q_end_(),
         q_length_(0), t_name_(t_name, t_name_length), t_id_(), t_begin_(t_begin - 1),
         t_end_(), t_length_(0), strand_(flag & 0x10), length_(), error_(),
-        cigar_(cigar, cigar_length), is_valid_(!(flag & 0x4)),
+        identity_(0), mapping_quality_(mapping_quality), cigar_(cigar, cigar_length),
+        is_valid_(!(flag & 0x4)),
         is_transmuted_(false), breaking_points_() {
 
     if (cigar_.size() < 2 && is_valid_) {
@@ -69,20 +74,25 @@ Overlap::Overlap(const char* q_name, uint32_t q_name_length, uint32_t flag,
         }
 
         uint32_t q_alignment_length = 0, q_clip_length = 0, t_alignment_length = 0;
+        uint32_t num_matches = 0, num_columns = 0;
         for (uint32_t i = 0, j = 0; i < cigar_.size(); ++i) {
             if (cigar_[i] == 'M' || cigar_[i] == '=' || cigar_[i] == 'X') {
                 auto num_bases = atoi(&cigar_[j]);
                 j = i + 1;
                 q_alignment_length += num_bases;
                 t_alignment_length += num_bases;
+                num_matches += cigar_[i] == 'X' ? 0 : num_bases;
+                num_columns += num_bases;
             } else if (cigar_[i] == 'I') {
                 auto num_bases = atoi(&cigar_[j]);
                 j = i + 1;
                 q_alignment_length += num_bases;
+                num_columns += num_bases;
             } else if (cigar_[i] == 'D' || cigar_[i] == 'N') {
                 auto num_bases = atoi(&cigar_[j]);
                 j = i + 1;
                 t_alignment_length += num_bases;
+                num_columns += cigar_[i] == 'D' ? num_bases : 0;
             } else if (cigar_[i] == 'S' || cigar_[i] == 'H') {
                 q_clip_length += atoi(&cigar_[j]);
                 j = i + 1;
@@ -104,13 +114,14 @@ Overlap::Overlap(const char* q_name, uint32_t q_name_length, uint32_t flag,
         length_ = std::max(q_alignment_length, t_alignment_length);
         error_ = 1 - std::min(q_alignment_length, t_alignment_length) /
             static_cast<double>(length_);
+        identity_ = num_columns == 0 ? 0 : num_matches / static_cast<double>(num_columns);
     }
 }
 
 Overlap::Overlap()
         : q_name_(), q_id_(), q_begin_(), q_end_(), q_length_(), t_name_(),
         t_id_(), t_begin_(), t_end_(), t_length_(), strand_(), length_(),
-        error_(), cigar_(), is_valid_(true), is_transmuted_(true),
+        error_(), identity_(), mapping_quality_(), cigar_(), is_valid_(true), is_transmuted_(true),
         breaking_points_(), dual_breaking_points_() {
 }
 
@@ -176,6 +187,25 @@ void Overlap::transmute(const std::vector<std::unique_ptr<Sequence>>& sequences,
     is_transmuted_ = true;
 }
 
+void Overlap::align(const std::vector<std::unique_ptr<Sequence>>& sequences) {
+
+    if (!is_transmuted_) {
+        fprintf(stderr, "[racon::Overlap::align] error: "
+            "overlap is not transmuted!\n");
+        exit(1);
+    }
+
+    if (!breaking_points_.empty() || !cigar_.empty()) {
+        return;
+    }
+
+    const char* q = !strand_ ? &(sequences[q_id_]->data()[q_begin_]) :
+        &(sequences[q_id_]->reverse_complement()[q_length_ - q_end_]);
+    const char* t = &(sequences[t_id_]->data()[t_begin_]);
+
+    align_overlaps(q, q_end_ - q_begin_, t, t_end_ - t_begin_);
+}
+
 void Overlap::find_breaking_points(const std::vector<std::unique_ptr<Sequence>>& sequences,
     uint32_t window_length) {
 
@@ -189,19 +219,55 @@ void Overlap::find_breaking_points(const std::vector<std::unique_ptr<Sequence>>&
         return;
     }
 
-    if (cigar_.empty()) {
-        const char* q = !strand_ ? &(sequences[q_id_]->data()[q_begin_]) :
-            &(sequences[q_id_]->reverse_complement()[q_length_ - q_end_]);
-        const char* t = &(sequences[t_id_]->data()[t_begin_]);
-
-        align_overlaps(q, q_end_ - q_begin_, t, t_end_ - t_begin_);
-    }
+    align(sequences);
 
     find_breaking_points_from_cigar(window_length);
 
     std::string().swap(cigar_);
 }
 
+double Overlap::estimate_quality(const std::vector<std::unique_ptr<Sequence>>& sequences,
+    uint32_t window_length, double min_length) const {
+
+    if (!is_transmuted_) {
+        fprintf(stderr, "[racon::Overlap::estimate_quality] error: "
+            "overlap is not transmuted!\n");
+        exit(1);
+    }
+
+    const auto& quality = sequences[q_id_]->quality();
+    if (quality.empty()) {
+        return std::numeric_limits<double>::max();
+    }
+
+    double max_quality = -1;
+    if (t_end_ <= t_begin_ || q_end_ <= q_begin_) {
+        return max_quality;
+    }
+
+    // reverse complemented segments cover the same bases in reverse order
+    double ratio = (q_end_ - q_begin_) / static_cast<double>(t_end_ - t_begin_);
+    for (uint32_t t = t_begin_; t < t_end_;) {
+        uint32_t next = std::min(t_end_, (t / window_length + 1) * window_length);
+        uint32_t begin = (t - t_begin_) * ratio;
+        uint32_t end = (next - t_begin_) * ratio;
+        t = next;
+        if (end - begin < min_length) {
+            continue;
+        }
+
+        uint32_t offset = strand_ ? q_end_ - end : q_begin_ + begin;
+        uint64_t quality_sum = 0;
+        for (uint32_t i = offset; i < offset + end - begin; ++i) {
+            quality_sum += static_cast<uint32_t>(quality[i]) - 33;
+        }
+        max_quality = std::max(max_quality,
+            quality_sum / static_cast<double>(end - begin));
+    }
+
+    return max_quality;
+}
+
 void Overlap::align_overlaps(const char* q, uint32_t q_length, const char* t, uint32_t t_length)
 {
     // align overlaps with edlib
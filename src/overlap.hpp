@@ -33,6 +33,15 @@ class Overlap {
 public:
     ~Overlap() = default;
 
+    // names are available only until the overlap is transmuted
+    const std::string& q_name() const {
+        return q_name_;
+    }
+
+    const std::string& t_name() const {
+        return t_name_;
+    }
+
     uint32_t q_id() const {
         return q_id_;
     }
@@ -41,6 +50,14 @@ public:
         return t_id_;
     }
 
+    uint32_t t_begin() const {
+        return t_begin_;
+    }
+
+    uint32_t t_end() const {
+        return t_end_;
+    }
+
     uint32_t strand() const {
         return strand_;
     }
@@ -61,6 +78,21 @@ public:
         return error_;
     }
 
+    /*!
+     * @brief Fraction of matching bases as reported by the overlapper (PAF
+     * matching bases over block length, one minus the MHAP error estimate);
+     * for SAM input it is derived from the CIGAR string, where mismatches are
+     * known only from =/X operations
+     */
+    double identity() const {
+        return identity_;
+    }
+
+    // 0 for MHAP input, which has none
+    uint32_t mapping_quality() const {
+        return mapping_quality_;
+    }
+
     const std::string& cigar() const {
         return cigar_;
     }
@@ -69,18 +101,43 @@ public:
         return breaking_points_;
     }
 
+    // approximate memory footprint
+    uint64_t num_bytes() const {
+        return sizeof(Overlap) + q_name_.capacity() + t_name_.capacity() +
+            cigar_.capacity() + (breaking_points_.capacity() +
+            dual_breaking_points_.capacity()) * sizeof(std::pair<uint32_t, uint32_t>);
+    }
+
+    /*!
+     * @brief Aligns the overlap with edlib unless it already has a cigar
+     * string or breaking points
+     */
+    void align(const std::vector<std::unique_ptr<Sequence>>& sequences);
+
     void find_breaking_points(const std::vector<std::unique_ptr<Sequence>>& sequences,
         uint32_t window_length);
 
+    /*!
+     * @brief Estimates the highest average base quality of segments which the
+     * overlap would add to windows, without aligning it; segment boundaries
+     * on the query are interpolated linearly from window boundaries on the
+     * target and segments shorter than min_length are ignored (returns -1 if
+     * none are left, or the maximal value if the query has no qualities)
+     */
+    double estimate_quality(const std::vector<std::unique_ptr<Sequence>>& sequences,
+        uint32_t window_length, double min_length) const;
+
     friend bioparser::MhapParser<Overlap>;
     friend bioparser::PafParser<Overlap>;
     friend bioparser::SamParser<Overlap>;
+    friend class OverlapSpanSource;
+    friend class CPUBatchAligner;
 
 #ifdef CUDA_ENABLED
     friend class CUDABatchAligner;
 #endif
 private:
-    Overlap(uint64_t a_id, uint64_t b_id, double accuracy, uint32_t minmers,
+    Overlap(uint64_t a_id, uint64_t b_id, double error, uint32_t minmers,
         uint32_t a_rc, uint32_t a_begin, uint32_t a_end, uint32_t a_length,
         uint32_t b_rc, uint32_t b_begin, uint32_t b_end, uint32_t b_length);
     Overlap(const char* q_name, uint32_t q_name_length, uint32_t q_length,
@@ -115,6 +172,8 @@ private:
     uint32_t strand_;
     uint32_t length_;
     double error_;
+    double identity_;
+    uint32_t mapping_quality_;
     std::string cigar_;
 
     bool is_valid_;
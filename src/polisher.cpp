@@ -4,7 +4,16 @@
  * @brief Polisher class source file
  */
 
+#include <unistd.h>
+#include <zlib.h>
+#include <sys/stat.h>
+
 #include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <numeric>
 #include <unordered_set>
 #include <iostream>
 
@@ -12,6 +21,8 @@
 #include "sequence.hpp"
 #include "window.hpp"
 #include "logger.hpp"
+#include "checkpoint.hpp"
+#include "numa.hpp"
 #include "polisher.hpp"
 #ifdef CUDA_ENABLED
 #include "cuda/cudapolisher.hpp"
@@ -19,11 +30,14 @@
 
 #include "bioparser/bioparser.hpp"
 #include "thread_pool/thread_pool.hpp"
-#include "spoa/spoa.hpp"
 
 namespace racon {
 
 constexpr uint32_t kChunkSize = 1024 * 1024 * 1024; // ~ 1GB
+// memory footprints of inputs are extrapolated from their first chunk
+constexpr uint32_t kSampleSize = 16 * 1024 * 1024; // ~ 16MB
+// allocator overhead and transient buffers on top of accounted bytes
+constexpr double kMemoryOverhead = 1.2;
 
 template<class T>
 uint64_t shrinkToFit(std::vector<std::unique_ptr<T>>& src, uint64_t begin) {
@@ -52,12 +66,114 @@ uint64_t shrinkToFit(std::vector<std::unique_ptr<T>>& src, uint64_t begin) {
     return num_deletions;
 }
 
+template<class T>
+uint64_t numBytes(const std::vector<std::unique_ptr<T>>& src) {
+
+    uint64_t num_bytes = src.capacity() * sizeof(std::unique_ptr<T>);
+    for (const auto& it: src) {
+        if (it != nullptr) {
+            num_bytes += it->num_bytes();
+        }
+    }
+    return num_bytes;
+}
+
+bool isSuffix(const std::string& src, const std::string& suffix) {
+    if (src.size() < suffix.size()) {
+        return false;
+    }
+    return src.compare(src.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+// number of uncompressed bytes of a file, which is extrapolated from the
+// compression ratio of the beginning of gzipped files
+uint64_t inputSize(const std::string& path) {
+
+    struct stat status;
+    if (stat(path.c_str(), &status) != 0) {
+        return 0;
+    }
+    uint64_t size = status.st_size;
+    if (!isSuffix(path, ".gz")) {
+        return size;
+    }
+
+    gzFile file = gzopen(path.c_str(), "r");
+    if (file == nullptr) {
+        return size;
+    }
+    std::vector<char> buffer(kSampleSize);
+    int32_t n = gzread(file, buffer.data(), buffer.size());
+    int64_t offset = gzoffset(file);
+    gzclose(file);
+
+    if (n <= 0 || offset <= 0) {
+        return size;
+    }
+    if (static_cast<uint32_t>(n) < kSampleSize) {
+        return n;
+    }
+    return size * (n / static_cast<double>(offset));
+}
+
+// parses the first chunk of a source into dst (all of it if the size is
+// unknown) and returns the factor extrapolating it to the whole source
+template<class T>
+double sampleSource(Source<T>& source, std::vector<std::unique_ptr<T>>& dst) {
+
+    source.reset();
+    if (source.size() == 0) {
+        while (source.parse(dst, kChunkSize)) {
+        }
+        return 1;
+    }
+    if (!source.parse(dst, kSampleSize)) {
+        return 1;
+    }
+    return std::max(1.0, source.size() / static_cast<double>(kSampleSize));
+}
+
+std::unique_ptr<Source<Sequence>> createSequenceSource(
+    const std::string& path) {
+
+    if (isSuffix(path, ".fasta") || isSuffix(path, ".fasta.gz") ||
+        isSuffix(path, ".fna") || isSuffix(path, ".fna.gz") ||
+        isSuffix(path, ".fa") || isSuffix(path, ".fa.gz")) {
+        return createSource(bioparser::createParser<bioparser::FastaParser, Sequence>(
+            path), inputSize(path));
+    } else if (isSuffix(path, ".fastq") || isSuffix(path, ".fastq.gz") ||
+        isSuffix(path, ".fq") || isSuffix(path, ".fq.gz")) {
+        return createSource(bioparser::createParser<bioparser::FastqParser, Sequence>(
+            path), inputSize(path));
+    }
+    return nullptr;
+}
+
+std::unique_ptr<Source<Overlap>> createOverlapSource(
+    const std::string& path) {
+
+    if (isSuffix(path, ".mhap") || isSuffix(path, ".mhap.gz")) {
+        return createSource(bioparser::createParser<bioparser::MhapParser, Overlap>(
+            path), inputSize(path));
+    } else if (isSuffix(path, ".paf") || isSuffix(path, ".paf.gz")) {
+        return createSource(bioparser::createParser<bioparser::PafParser, Overlap>(
+            path), inputSize(path));
+    } else if (isSuffix(path, ".sam") || isSuffix(path, ".sam.gz")) {
+        return createSource(bioparser::createParser<bioparser::SamParser, Overlap>(
+            path), inputSize(path));
+    }
+    return nullptr;
+}
+
 std::unique_ptr<Polisher> createPolisher(const std::string& sequences_path,
     const std::string& overlaps_path, const std::string& target_path,
     PolisherType type, uint32_t window_length, double quality_threshold,
     double error_threshold, bool trim, int8_t match, int8_t mismatch, int8_t gap,
     uint32_t num_threads, uint32_t cudapoa_batches, bool cuda_banded_alignment,
-    uint32_t cudaaligner_batches, uint32_t cudaaligner_band_width) {
+    uint32_t cudaaligner_batches, uint32_t cudaaligner_band_width,
+    const std::string& regions_path, const std::string& checkpoint_directory,
+    uint32_t shard_id, uint32_t num_shards, uint64_t batch_size,
+    uint64_t max_memory) {
 
     if (type != PolisherType::kC && type != PolisherType::kF) {
         fprintf(stderr, "[racon::createPolisher] error: invalid polisher type!\n");
@@ -69,27 +185,13 @@ std::unique_ptr<Polisher> createPolisher(const std::string& sequences_path,
         exit(1);
     }
 
-    std::unique_ptr<bioparser::Parser<Sequence>> sparser = nullptr,
-        tparser = nullptr;
-    std::unique_ptr<bioparser::Parser<Overlap>> oparser = nullptr;
-
-    auto is_suffix = [](const std::string& src, const std::string& suffix) -> bool {
-        if (src.size() < suffix.size()) {
-            return false;
-        }
-        return src.compare(src.size() - suffix.size(), suffix.size(), suffix) == 0;
-    };
+    if (num_shards == 0 || shard_id >= num_shards) {
+        fprintf(stderr, "[racon::createPolisher] error: invalid shard!\n");
+        exit(1);
+    }
 
-    if (is_suffix(sequences_path, ".fasta") || is_suffix(sequences_path, ".fasta.gz") ||
-        is_suffix(sequences_path, ".fna") || is_suffix(sequences_path, ".fna.gz") ||
-        is_suffix(sequences_path, ".fa") || is_suffix(sequences_path, ".fa.gz")) {
-        sparser = bioparser::createParser<bioparser::FastaParser, Sequence>(
-            sequences_path);
-    } else if (is_suffix(sequences_path, ".fastq") || is_suffix(sequences_path, ".fastq.gz") ||
-        is_suffix(sequences_path, ".fq") || is_suffix(sequences_path, ".fq.gz")) {
-        sparser = bioparser::createParser<bioparser::FastqParser, Sequence>(
-            sequences_path);
-    } else {
+    auto sparser = createSequenceSource(sequences_path);
+    if (sparser == nullptr) {
         fprintf(stderr, "[racon::createPolisher] error: "
             "file %s has unsupported format extension (valid extensions: "
             ".fasta, .fasta.gz, .fna, .fna.gz, .fa, .fa.gz, .fastq, .fastq.gz, "
@@ -98,32 +200,16 @@ std::unique_ptr<Polisher> createPolisher(const std::string& sequences_path,
         exit(1);
     }
 
-    if (is_suffix(overlaps_path, ".mhap") || is_suffix(overlaps_path, ".mhap.gz")) {
-        oparser = bioparser::createParser<bioparser::MhapParser, Overlap>(
-            overlaps_path);
-    } else if (is_suffix(overlaps_path, ".paf") || is_suffix(overlaps_path, ".paf.gz")) {
-        oparser = bioparser::createParser<bioparser::PafParser, Overlap>(
-            overlaps_path);
-    } else if (is_suffix(overlaps_path, ".sam") || is_suffix(overlaps_path, ".sam.gz")) {
-        oparser = bioparser::createParser<bioparser::SamParser, Overlap>(
-            overlaps_path);
-    } else {
+    auto oparser = createOverlapSource(overlaps_path);
+    if (oparser == nullptr) {
         fprintf(stderr, "[racon::createPolisher] error: "
             "file %s has unsupported format extension (valid extensions: "
             ".mhap, .mhap.gz, .paf, .paf.gz, .sam, .sam.gz)!\n", overlaps_path.c_str());
         exit(1);
     }
 
-    if (is_suffix(target_path, ".fasta") || is_suffix(target_path, ".fasta.gz") ||
-        is_suffix(target_path, ".fna") || is_suffix(target_path, ".fna.gz") ||
-        is_suffix(target_path, ".fa") || is_suffix(target_path, ".fa.gz")) {
-        tparser = bioparser::createParser<bioparser::FastaParser, Sequence>(
-            target_path);
-    } else if (is_suffix(target_path, ".fastq") || is_suffix(target_path, ".fastq.gz") ||
-        is_suffix(target_path, ".fq") || is_suffix(target_path, ".fq.gz")) {
-        tparser = bioparser::createParser<bioparser::FastqParser, Sequence>(
-            target_path);
-    } else {
+    auto tparser = createSequenceSource(target_path);
+    if (tparser == nullptr) {
         fprintf(stderr, "[racon::createPolisher] error: "
             "file %s has unsupported format extension (valid extensions: "
             ".fasta, .fasta.gz, .fna, .fna.gz, .fa, .fa.gz, .fastq, .fastq.gz, "
@@ -132,6 +218,30 @@ std::unique_ptr<Polisher> createPolisher(const std::string& sequences_path,
         exit(1);
     }
 
+    if (!regions_path.empty() && !isSuffix(regions_path, ".bed") &&
+        !isSuffix(regions_path, ".bed.gz")) {
+        fprintf(stderr, "[racon::createPolisher] error: "
+            "file %s has unsupported format extension (valid extensions: "
+            ".bed, .bed.gz)!\n", regions_path.c_str());
+        exit(1);
+    }
+
+    std::unique_ptr<Checkpoint> checkpoint = nullptr;
+    if (!checkpoint_directory.empty()) {
+        // windows can be restored only if they were generated from the same
+        // input files with the same parameters
+        std::string signature = sequences_path + "\n" + overlaps_path + "\n" +
+            target_path + "\n" + regions_path + "\n" +
+            std::to_string(static_cast<int32_t>(type)) + " " +
+            std::to_string(window_length) + " " +
+            std::to_string(quality_threshold) + " " +
+            std::to_string(error_threshold) + " " + std::to_string(trim) + " " +
+            std::to_string(match) + " " + std::to_string(mismatch) + " " +
+            std::to_string(gap) + "\n" + std::to_string(shard_id) + "/" +
+            std::to_string(num_shards) + "\n";
+        checkpoint = createCheckpoint(checkpoint_directory, signature);
+    }
+
     if (cudapoa_batches > 0 || cudaaligner_batches > 0)
     {
 #ifdef CUDA_ENABLED
@@ -140,7 +250,8 @@ std::unique_ptr<Polisher> createPolisher(const std::string& sequences_path,
                     std::move(oparser), std::move(tparser), type, window_length,
                     quality_threshold, error_threshold, trim, match, mismatch, gap,
                     num_threads, cudapoa_batches, cuda_banded_alignment, cudaaligner_batches,
-                    cudaaligner_band_width));
+                    cudaaligner_band_width, regions_path, std::move(checkpoint),
+                    shard_id, num_shards, batch_size, max_memory));
 #else
         fprintf(stderr, "[racon::createPolisher] error: "
                 "Attemping to use CUDA when CUDA support is not available.\n"
@@ -155,267 +266,928 @@ std::unique_ptr<Polisher> createPolisher(const std::string& sequences_path,
         return std::unique_ptr<Polisher>(new Polisher(std::move(sparser),
                     std::move(oparser), std::move(tparser), type, window_length,
                     quality_threshold, error_threshold, trim, match, mismatch, gap,
-                    num_threads));
+                    num_threads, regions_path, std::move(checkpoint), shard_id,
+                    num_shards, batch_size, max_memory));
+    }
+}
+
+std::unique_ptr<Polisher> createPolisher(const SequenceSpan* sequences,
+    uint64_t num_sequences, const OverlapSpan* overlaps, uint64_t num_overlaps,
+    const SequenceSpan* targets, uint64_t num_targets, PolisherType type,
+    uint32_t window_length, double quality_threshold, double error_threshold,
+    bool trim, int8_t match, int8_t mismatch, int8_t gap, uint32_t num_threads,
+    uint64_t batch_size) {
+
+    if (type != PolisherType::kC && type != PolisherType::kF) {
+        fprintf(stderr, "[racon::createPolisher] error: invalid polisher type!\n");
+        exit(1);
+    }
+
+    if (window_length == 0) {
+        fprintf(stderr, "[racon::createPolisher] error: invalid window length!\n");
+        exit(1);
+    }
+
+    if ((sequences == nullptr && num_sequences != 0) ||
+        (overlaps == nullptr && num_overlaps != 0) ||
+        (targets == nullptr && num_targets != 0)) {
+        fprintf(stderr, "[racon::createPolisher] error: invalid spans!\n");
+        exit(1);
     }
+
+    std::unique_ptr<Polisher> polisher(new Polisher(createSource(sequences,
+        num_sequences), createSource(overlaps, num_overlaps), createSource(
+        targets, num_targets), type, window_length, quality_threshold,
+        error_threshold, trim, match, mismatch, gap, num_threads, "", nullptr,
+        0, 1, batch_size, 0));
+
+    // sequences are copied from their spans once and borrowed by each batch
+    // (and by later jobs) instead of being copied again on every pass
+    polisher->preload_sequences();
+
+    return polisher;
 }
 
-Polisher::Polisher(std::unique_ptr<bioparser::Parser<Sequence>> sparser,
-    std::unique_ptr<bioparser::Parser<Overlap>> oparser,
-    std::unique_ptr<bioparser::Parser<Sequence>> tparser,
+Polisher::Polisher(std::unique_ptr<Source<Sequence>> sparser,
+    std::unique_ptr<Source<Overlap>> oparser,
+    std::unique_ptr<Source<Sequence>> tparser,
     PolisherType type, uint32_t window_length, double quality_threshold,
     double error_threshold, bool trim, int8_t match, int8_t mismatch, int8_t gap,
-    uint32_t num_threads)
+    uint32_t num_threads, const std::string& regions_path,
+    std::unique_ptr<Checkpoint> checkpoint, uint32_t shard_id,
+    uint32_t num_shards, uint64_t batch_size, uint64_t max_memory)
         : sparser_(std::move(sparser)), oparser_(std::move(oparser)),
         tparser_(std::move(tparser)), type_(type), quality_threshold_(
         quality_threshold), error_threshold_(error_threshold), trim_(trim),
-        alignment_engines_(), sequences_(), dummy_quality_(window_length, '!'),
-        window_length_(window_length), windows_(),
-        thread_pool_(thread_pool::createThreadPool(num_threads)),
-        thread_to_id_(), logger_(new Logger()) {
+        backend_parameters_({match, mismatch, gap, trim, window_length, 0,
+        error_threshold}),
+        consensus_backends_names_(2, "spoa"), aligner_backend_name_("edlib"),
+        consensus_backends_(), aligner_backends_(), sequences_(),
+        preloaded_sequences_(), borrowed_sequences_(), targets_ids_(),
+        targets_coverages_(), dummy_quality_(window_length, '!'),
+        window_length_(window_length), windows_(), regions_path_(regions_path),
+        regions_(), checkpoint_(std::move(checkpoint)), shard_id_(shard_id),
+        num_shards_(num_shards), batch_size_(batch_size), prefetch_bytes_(0),
+        is_quality_prefilter_(false), max_coverage_(0),
+        max_memory_(max_memory), memory_batch_size_(0), num_targets_(0),
+        num_batches_(0), has_remaining_targets_(true),
+        shards_lengths_(num_shards, 0), targets_names_(), thread_pool_(thread_pool::createThreadPool(num_threads)),
+        thread_to_id_(), worker_to_node_(), logger_(new Logger()), metrics_(new Metrics()),
+        tracer_(new Tracer(thread_pool_->thread_identifiers())) {
 
     uint32_t id = 0;
     for (const auto& it: thread_pool_->thread_identifiers()) {
         thread_to_id_[it] = id++;
     }
-
-    for (uint32_t i = 0; i < num_threads; ++i) {
-        alignment_engines_.emplace_back(spoa::createAlignmentEngine(
-            spoa::AlignmentType::kNW, match, mismatch, gap));
-        alignment_engines_.back()->prealloc(window_length_, 5);
-    }
 }
 
 Polisher::~Polisher() {
     logger_->total("[racon::Polisher::] total =");
 }
 
-void Polisher::initialize() {
+void Polisher::preload_sequences() {
 
-    if (!windows_.empty()) {
-        fprintf(stderr, "[racon::Polisher::initialize] warning: "
-            "object already initialized!\n");
+    if (!preloaded_sequences_.empty()) {
         return;
     }
 
     logger_->log();
 
-    tparser_->reset();
-    tparser_->parse(sequences_, -1);
+    sparser_->reset();
+    sparser_->parse(preloaded_sequences_, -1);
 
-    uint64_t targets_size = sequences_.size();
-    if (targets_size == 0) {
-        fprintf(stderr, "[racon::Polisher::initialize] error: "
-            "empty target sequences set!\n");
+    if (preloaded_sequences_.empty()) {
+        fprintf(stderr, "[racon::Polisher::preload_sequences] error: "
+            "empty sequences set!\n");
         exit(1);
     }
 
-    std::unordered_map<std::string, uint64_t> name_to_id;
-    std::unordered_map<uint64_t, uint64_t> id_to_id;
-    for (uint64_t i = 0; i < targets_size; ++i) {
-        name_to_id[sequences_[i]->name() + "t"] = i;
-        id_to_id[i << 1 | 1] = i;
+    logger_->log("[racon::Polisher::preload_sequences] loaded sequences");
+}
+
+bool Polisher::reset(const std::string& overlaps_path,
+    const std::string& target_path) {
+
+    if (access(overlaps_path.c_str(), R_OK) != 0 ||
+        access(target_path.c_str(), R_OK) != 0) {
+        return false;
     }
 
-    std::vector<bool> has_name(targets_size, true);
-    std::vector<bool> has_data(targets_size, true);
-    std::vector<bool> has_reverse_data(targets_size, false);
+    auto oparser = createOverlapSource(overlaps_path);
+    auto tparser = createSequenceSource(target_path);
+    if (oparser == nullptr || tparser == nullptr) {
+        return false;
+    }
 
-    logger_->log("[racon::Polisher::initialize] loaded target sequences");
-    logger_->log();
+    return reset(std::move(oparser), std::move(tparser));
+}
 
-    uint64_t sequences_size = 0, total_sequences_length = 0;
+bool Polisher::reset(const OverlapSpan* overlaps, uint64_t num_overlaps,
+    const SequenceSpan* targets, uint64_t num_targets) {
 
-    sparser_->reset();
-    while (true) {
-        uint64_t l = sequences_.size();
-        auto status = sparser_->parse(sequences_, kChunkSize);
+    if ((overlaps == nullptr && num_overlaps != 0) ||
+        (targets == nullptr && num_targets != 0)) {
+        return false;
+    }
 
-        uint64_t n = 0;
-        for (uint64_t i = l; i < sequences_.size(); ++i, ++sequences_size) {
-            total_sequences_length += sequences_[i]->data().size();
+    return reset(createSource(overlaps, num_overlaps), createSource(targets,
+        num_targets));
+}
 
-            auto it = name_to_id.find(sequences_[i]->name() + "t");
-            if (it != name_to_id.end()) {
-                if (sequences_[i]->data().size() != sequences_[it->second]->data().size() ||
-                    sequences_[i]->quality().size() != sequences_[it->second]->quality().size()) {
+bool Polisher::reset(std::unique_ptr<Source<Overlap>> oparser,
+    std::unique_ptr<Source<Sequence>> tparser) {
 
-                    fprintf(stderr, "[racon::Polisher::initialize] error: "
-                        "duplicate sequence %s with unequal data\n",
-                        sequences_[i]->name().c_str());
-                    exit(1);
-                }
+    oparser_.swap(oparser);
+    tparser_.swap(tparser);
+    if (prefetch_bytes_ != 0) {
+        oparser_ = createPrefetchSource(std::move(oparser_), prefetch_bytes_);
+        tparser_ = createPrefetchSource(std::move(tparser_), prefetch_bytes_);
+    }
 
-                name_to_id[sequences_[i]->name() + "q"] = it->second;
-                id_to_id[sequences_size << 1 | 0] = it->second;
+    // persisted windows, regions and shards belong to the previous target
+    // sequences
+    checkpoint_.reset();
+    regions_path_.clear();
+    regions_.clear();
+    shard_id_ = 0;
+    num_shards_ = 1;
 
-                sequences_[i].reset();
-                ++n;
-            } else {
-                name_to_id[sequences_[i]->name() + "q"] = i - n;
-                id_to_id[sequences_size << 1 | 0] = i - n;
-            }
-        }
+    std::vector<std::shared_ptr<Window>>().swap(windows_);
+    release_sequences();
+    targets_ids_.clear();
+    targets_coverages_.clear();
+
+    memory_batch_size_ = 0;
+    num_targets_ = 0;
+    num_batches_ = 0;
+    has_remaining_targets_ = true;
+    shards_lengths_.assign(num_shards_, 0);
+    std::unordered_set<std::string>().swap(targets_names_);
+
+    return true;
+}
 
-        shrinkToFit(sequences_, l);
+void Polisher::load_regions() {
 
-        if (!status) {
-            break;
-        }
+    if (regions_path_.empty() || !regions_.empty()) {
+        return;
     }
 
-    if (sequences_size == 0) {
-        fprintf(stderr, "[racon::Polisher::initialize] error: "
-            "empty sequences set!\n");
+    gzFile file = gzopen(regions_path_.c_str(), "r");
+    if (file == nullptr) {
+        fprintf(stderr, "[racon::Polisher::load_regions] error: "
+            "unable to open file %s!\n", regions_path_.c_str());
         exit(1);
     }
 
-    has_name.resize(sequences_.size(), false);
-    has_data.resize(sequences_.size(), false);
-    has_reverse_data.resize(sequences_.size(), false);
-
-    WindowType window_type = static_cast<double>(total_sequences_length) /
-        sequences_size <= 1000 ? WindowType::kNGS : WindowType::kTGS;
-
-    logger_->log("[racon::Polisher::initialize] loaded sequences");
-    logger_->log();
+    std::vector<char> buffer(65536);
+    std::string line = "";
+    uint64_t line_id = 0;
 
-    std::vector<std::unique_ptr<Overlap>> overlaps;
+    while (gzgets(file, buffer.data(), buffer.size()) != nullptr) {
+        line += buffer.data();
+        if (line.back() != '\n' && !gzeof(file)) {
+            continue;
+        }
+        ++line_id;
 
-    auto remove_invalid_overlaps = [&](uint64_t begin, uint64_t end) -> void {
-        for (uint64_t i = begin; i < end; ++i) {
-            if (overlaps[i] == nullptr) {
-                continue;
-            }
-            if (overlaps[i]->error() > error_threshold_ ||
-                overlaps[i]->q_id() == overlaps[i]->t_id()) {
-                overlaps[i].reset();
-                continue;
-            }
-            if (type_ == PolisherType::kC) {
-                for (uint64_t j = i + 1; j < end; ++j) {
-                    if (overlaps[j] == nullptr) {
-                        continue;
-                    }
-                    if (overlaps[i]->length() > overlaps[j]->length()) {
-                        overlaps[j].reset();
-                    } else {
-                        overlaps[i].reset();
-                        break;
-                    }
-                }
-            }
+        while (!line.empty() && (line.back() == '\n' || line.back() == '\r')) {
+            line.pop_back();
+        }
+        if (line.empty() || line.front() == '#' || line.compare(0, 5, "track") == 0 ||
+            line.compare(0, 7, "browser") == 0) {
+            line.clear();
+            continue;
         }
-    };
 
-    oparser_->reset();
-    uint64_t l = 0;
-    while (true) {
-        auto status = oparser_->parse(overlaps, kChunkSize);
+        std::string name = line.substr(0, line.find_first_of(" \t"));
+        const char* begin_ptr = line.c_str() + name.size();
+        char* end_ptr = nullptr;
 
-        uint64_t c = l;
-        for (uint64_t i = l; i < overlaps.size(); ++i) {
-            overlaps[i]->transmute(sequences_, name_to_id, id_to_id);
+        uint64_t begin = strtoull(begin_ptr, &end_ptr, 10);
+        bool is_valid = !name.empty() && end_ptr != begin_ptr;
 
-            if (!overlaps[i]->is_valid()) {
-                overlaps[i].reset();
-                continue;
-            }
+        begin_ptr = end_ptr;
+        uint64_t end = strtoull(begin_ptr, &end_ptr, 10);
+        is_valid &= end_ptr != begin_ptr && begin < end && end <= std::numeric_limits<uint32_t>::max();
 
-            while (overlaps[c] == nullptr) {
-                ++c;
-            }
-            if (overlaps[c]->q_id() != overlaps[i]->q_id()) {
-                remove_invalid_overlaps(c, i);
-                c = i;
-            }
-        }
-        if (!status) {
-            remove_invalid_overlaps(c, overlaps.size());
-            c = overlaps.size();
+        if (!is_valid) {
+            fprintf(stderr, "[racon::Polisher::load_regions] error: "
+                "invalid region at line %lu of file %s!\n", line_id,
+                regions_path_.c_str());
+            exit(1);
         }
 
-        for (uint64_t i = l; i < c; ++i) {
-            if (overlaps[i] == nullptr) {
-                continue;
-            }
+        regions_[name].emplace_back(begin, end);
+        line.clear();
+    }
+
+    gzclose(file);
 
-            if (overlaps[i]->strand()) {
-                has_reverse_data[overlaps[i]->q_id()] = true;
+    if (regions_.empty()) {
+        fprintf(stderr, "[racon::Polisher::load_regions] error: "
+            "empty regions set!\n");
+        exit(1);
+    }
+
+    for (auto& it: regions_) {
+        auto& intervals = it.second;
+        std::sort(intervals.begin(), intervals.end());
+
+        uint32_t n = 0;
+        for (uint32_t i = 1; i < intervals.size(); ++i) {
+            if (intervals[i].first <= intervals[n].second) {
+                intervals[n].second = std::max(intervals[n].second,
+                    intervals[i].second);
             } else {
-                has_data[overlaps[i]->q_id()] = true;
+                intervals[++n] = intervals[i];
             }
         }
+        intervals.resize(n + 1);
+    }
+}
 
-        uint64_t n = shrinkToFit(overlaps, l);
-        l = c - n;
+bool Polisher::initialize() {
 
-        if (!status) {
-            break;
-        }
+    if (!windows_.empty()) {
+        fprintf(stderr, "[racon::Polisher::initialize] warning: "
+            "object already initialized!\n");
+        return true;
     }
 
-    std::unordered_map<std::string, uint64_t>().swap(name_to_id);
-    std::unordered_map<uint64_t, uint64_t>().swap(id_to_id);
+    if (!has_remaining_targets_) {
+        return false;
+    }
 
-    if (overlaps.empty()) {
-        fprintf(stderr, "[racon::Polisher::initialize] error: "
-            "empty overlap set!\n");
-        exit(1);
+    // consensus depends on options which are set after the polisher is
+    // created, hence they are added to the signature only now
+    if (checkpoint_ != nullptr) {
+        std::string options = std::to_string(backend_parameters_.match) + " " +
+            std::to_string(backend_parameters_.mismatch) + " " +
+            std::to_string(backend_parameters_.gap) + " " +
+            std::to_string(backend_parameters_.trim) + " " +
+            std::to_string(backend_parameters_.window_length) + " " +
+            std::to_string(backend_parameters_.band_width) + " " +
+            std::to_string(max_coverage_) + " " +
+            std::to_string(is_quality_prefilter_) + "\n" +
+            consensus_backends_names_[0] + " " + consensus_backends_names_[1] +
+            " " + aligner_backend_name_ + "\n";
+        checkpoint_->open(options);
     }
 
-    logger_->log("[racon::Polisher::initialize] loaded overlaps");
+    // sequences of a batch which was not polished
+    release_sequences();
+
     logger_->log();
+    start_phase("load_targets");
+
+    // contig polishing keeps only the longest overlap of each sequence, which
+    // might belong to a target outside of this shard or batch (targets are
+    // also needed to project the memory footprint, for which their first
+    // chunk suffices)
+    if ((((num_shards_ > 1 || batch_size_ != 0 || max_memory_ != 0) &&
+        type_ == PolisherType::kC) || max_memory_ != 0) && num_targets_ == 0) {
+
+        double targets_length = 0, targets_bytes = 0;
+        if (type_ == PolisherType::kC) {
+            tparser_->reset();
+            while (true) {
+                std::vector<std::unique_ptr<Sequence>> targets;
+                auto status = tparser_->parse(targets, kChunkSize);
+                for (const auto& it: targets) {
+                    targets_names_.emplace(it->name());
+                    targets_length += it->data().size();
+                    targets_bytes += it->num_bytes();
+                }
+                if (!status) {
+                    break;
+                }
+            }
+        } else {
+            std::vector<std::unique_ptr<Sequence>> targets;
+            double scale = sampleSource(*tparser_, targets);
+            for (const auto& it: targets) {
+                targets_length += it->data().size() * scale;
+                targets_bytes += it->num_bytes() * scale;
+            }
+        }
 
-    std::vector<std::future<void>> thread_futures;
-    for (uint64_t i = 0; i < sequences_.size(); ++i) {
-        thread_futures.emplace_back(thread_pool_->submit(
-            [&](uint64_t j) -> void {
-                sequences_[j]->transmute(has_name[j], has_data[j], has_reverse_data[j]);
-            }, i));
+        if (max_memory_ != 0) {
+            project_memory(targets_length, targets_bytes);
+        }
     }
-    for (const auto& it: thread_futures) {
-        it.wait();
+
+    uint64_t batch_size = batch_size_;
+    if (memory_batch_size_ != 0 && (batch_size == 0 || memory_batch_size_ < batch_size)) {
+        batch_size = memory_batch_size_;
     }
 
-    find_overlap_breaking_points(overlaps);
+    // only a part of target sequences is polished at once (or only used
+    // preloaded sequences are borrowed)
+    bool is_partial = num_shards_ > 1 || batch_size != 0 ||
+        !preloaded_sequences_.empty();
 
-    logger_->log();
+    std::unordered_map<std::string, uint64_t> name_to_id;
+    std::unordered_map<uint64_t, uint64_t> id_to_id;
 
-    std::vector<uint64_t> id_to_first_window_id(targets_size + 1, 0);
-    for (uint64_t i = 0; i < targets_size; ++i) {
-        uint32_t k = 0;
-        for (uint32_t j = 0; j < sequences_[i]->data().size(); j += window_length_, ++k) {
+    targets_ids_.clear();
 
-            uint32_t length = std::min(j + window_length_,
-                static_cast<uint32_t>(sequences_[i]->data().size())) - j;
+    // targets are assigned greedily by length (in file order) to the least
+    // loaded shard, which is deterministic and needs a single pass
+    if (num_targets_ == 0) {
+        tparser_->reset();
+    }
+    uint64_t batch_length = 0;
+    while (has_remaining_targets_ && (batch_size == 0 || batch_length < batch_size)) {
+        uint64_t l = sequences_.size();
+        has_remaining_targets_ = tparser_->parse(sequences_, batch_size == 0 ?
+            kChunkSize : std::min<uint64_t>(kChunkSize, batch_size - batch_length));
 
-            windows_.emplace_back(createWindow(i, k, window_type,
-                &(sequences_[i]->data()[j]), length,
-                sequences_[i]->quality().empty() ? &(dummy_quality_[0]) :
-                &(sequences_[i]->quality()[j]), length));
+        for (uint64_t i = l; i < sequences_.size(); ++i, ++num_targets_) {
+            uint32_t shard = std::min_element(shards_lengths_.begin(),
+                shards_lengths_.end()) - shards_lengths_.begin();
+            shards_lengths_[shard] += sequences_[i]->data().size();
+
+            if (shard != shard_id_) {
+                sequences_[i].reset();
+                continue;
+            }
+
+            batch_length += sequences_[i]->data().size();
+            name_to_id[sequences_[i]->name() + "t"] = targets_ids_.size();
+            id_to_id[num_targets_ << 1 | 1] = targets_ids_.size();
+            targets_ids_.emplace_back(num_targets_);
         }
 
-        id_to_first_window_id[i + 1] = id_to_first_window_id[i] + k;
+        shrinkToFit(sequences_, l);
     }
 
-    targets_coverages_.resize(targets_size, 0);
+    stop_phase("load_targets");
 
-    for (uint64_t i = 0; i < overlaps.size(); ++i) {
+    uint64_t targets_size = sequences_.size();
+    if (targets_size == 0) {
+        targets_coverages_.clear();
+        if (num_targets_ == 0) {
+            fprintf(stderr, "[racon::Polisher::initialize] error: "
+                "empty target sequences set!\n");
+            exit(1);
+        }
+        if (num_batches_ == 0) {
+            fprintf(stderr, "[racon::Polisher::initialize] warning: "
+                "empty shard %u/%u!\n", shard_id_ + 1, num_shards_);
+        }
+        return false;
+    }
+    ++num_batches_;
+    metrics_->add("batches", 1);
+    metrics_->add("target_sequences", targets_size);
+
+    std::vector<bool> has_name(targets_size, true);
+    std::vector<bool> has_data(targets_size, true);
+    std::vector<bool> has_reverse_data(targets_size, false);
 
-        ++targets_coverages_[overlaps[i]->t_id()];
+    load_regions();
 
-        const auto& sequence = sequences_[overlaps[i]->q_id()];
-        const auto& breaking_points = overlaps[i]->breaking_points();
+    std::vector<std::vector<bool>> is_selected_window;
+    if (!regions_.empty()) {
+        bool has_selected_windows = false;
 
-        for (uint32_t j = 0; j < breaking_points.size(); j += 2) {
-            if (breaking_points[j + 1].second - breaking_points[j].second < 0.02 * window_length_) {
+        is_selected_window.resize(targets_size);
+        for (uint64_t i = 0; i < targets_size; ++i) {
+            uint32_t length = sequences_[i]->data().size();
+            is_selected_window[i].resize((length + window_length_ - 1) /
+                window_length_, false);
+
+            auto it = regions_.find(sequences_[i]->name());
+            if (it == regions_.end()) {
                 continue;
             }
+            for (const auto& jt: it->second) {
+                if (jt.first >= length) {
+                    continue;
+                }
+                uint32_t end = std::min(jt.second, length);
+                for (uint32_t k = jt.first / window_length_; k <= (end - 1) / window_length_; ++k) {
+                    is_selected_window[i][k] = true;
+                }
+                has_selected_windows = true;
+            }
+        }
 
-            if (!sequence->quality().empty() ||
-                !sequence->reverse_quality().empty()) {
+        if (!has_selected_windows && !is_partial) {
+            fprintf(stderr, "[racon::Polisher::initialize] error: "
+                "regions do not intersect any target sequence!\n");
+            exit(1);
+        }
+    }
 
-                const auto& quality = overlaps[i]->strand() ?
+    // windows which are selected and not yet persisted in the checkpoint
+    std::vector<std::vector<bool>> is_pending_window;
+    if (!is_selected_window.empty() || (checkpoint_ != nullptr &&
+        checkpoint_->size() > 0)) {
+
+        is_pending_window.resize(targets_size);
+        for (uint64_t i = 0; i < targets_size; ++i) {
+            uint32_t length = sequences_[i]->data().size();
+            is_pending_window[i].resize((length + window_length_ - 1) /
+                window_length_, true);
+
+            for (uint32_t k = 0; k < is_pending_window[i].size(); ++k) {
+                if ((!is_selected_window.empty() && !is_selected_window[i][k]) ||
+                    (checkpoint_ != nullptr && checkpoint_->contains(
+                        sequences_[i]->name(), k))) {
+
+                    is_pending_window[i][k] = false;
+                }
+            }
+        }
+    }
+
+    auto is_pending_overlap = [&](const std::unique_ptr<Overlap>& overlap) -> bool {
+        if (is_pending_window.empty()) {
+            return true;
+        }
+        const auto& is_pending = is_pending_window[overlap->t_id()];
+        for (uint64_t k = overlap->t_begin() / window_length_;
+            k < is_pending.size() && k * window_length_ < overlap->t_end(); ++k) {
+
+            if (is_pending[k]) {
+                return true;
+            }
+        }
+        return false;
+    };
+
+    if (batch_size != 0) {
+        logger_->log("[racon::Polisher::initialize] loaded target sequences "
+            "(batch " + std::to_string(num_batches_) + ")");
+    } else {
+        logger_->log("[racon::Polisher::initialize] loaded target sequences");
+    }
+    logger_->log();
+
+    std::vector<std::unique_ptr<Overlap>> overlaps;
+
+    // before transmutation overlaps can be checked for self overlaps only by
+    // comparing their names (MHAP ids of sequences and targets differ)
+    uint64_t num_error_overlaps = 0, num_self_overlaps = 0,
+        num_duplicate_overlaps = 0, num_quality_overlaps = 0;
+    auto remove_invalid_overlaps = [&](uint64_t begin, uint64_t end,
+        bool is_transmuted) -> void {
+
+        for (uint64_t i = begin; i < end; ++i) {
+            if (overlaps[i] == nullptr) {
+                continue;
+            }
+            if (overlaps[i]->error() > error_threshold_) {
+                overlaps[i].reset();
+                ++num_error_overlaps;
+                continue;
+            }
+            if (is_transmuted ? overlaps[i]->q_id() == overlaps[i]->t_id() :
+                !overlaps[i]->q_name().empty() &&
+                overlaps[i]->q_name() == overlaps[i]->t_name()) {
+                overlaps[i].reset();
+                ++num_self_overlaps;
+                continue;
+            }
+            if (type_ == PolisherType::kC) {
+                for (uint64_t j = i + 1; j < end; ++j) {
+                    if (overlaps[j] == nullptr) {
+                        continue;
+                    }
+                    ++num_duplicate_overlaps;
+                    if (overlaps[i]->length() > overlaps[j]->length()) {
+                        overlaps[j].reset();
+                    } else {
+                        overlaps[i].reset();
+                        break;
+                    }
+                }
+            }
+        }
+    };
+
+    // with sharding or batching, overlaps are parsed before sequences and
+    // only those which belong to loaded targets are kept, so that only
+    // sequences overlapping them are loaded
+    std::unordered_set<std::string> queries_names;
+    std::unordered_set<uint64_t> queries_ids;
+
+    if (is_partial) {
+        // 0 - unknown target, 1 - loaded target, 2 - any other target
+        auto target_status = [&](const std::unique_ptr<Overlap>& overlap) -> uint32_t {
+            if (!overlap->t_name().empty()) {
+                if (name_to_id.find(overlap->t_name() + "t") != name_to_id.end()) {
+                    return 1;
+                }
+                return targets_names_.count(overlap->t_name()) ? 2 : 0;
+            }
+            uint64_t t_id = overlap->t_id();
+            if (id_to_id.find(t_id << 1 | 1) != id_to_id.end()) {
+                return 1;
+            }
+            return t_id < targets_names_.size() ? 2 : 0;
+        };
+
+        auto is_same_query = [](const std::unique_ptr<Overlap>& lhs,
+            const std::unique_ptr<Overlap>& rhs) -> bool {
+            return lhs->q_name().empty() ? lhs->q_id() == rhs->q_id() :
+                lhs->q_name() == rhs->q_name();
+        };
+
+        start_phase("load_overlaps");
+
+        oparser_->reset();
+        uint64_t l = 0;
+        while (true) {
+            auto status = oparser_->parse(overlaps, kChunkSize);
+            metrics_->add("overlaps_parsed", overlaps.size() - l);
+
+            uint64_t c = l;
+            for (uint64_t i = l; i < overlaps.size(); ++i) {
+                if (!overlaps[i]->is_valid() || target_status(overlaps[i]) == 0) {
+                    overlaps[i].reset();
+                    continue;
+                }
+
+                while (overlaps[c] == nullptr) {
+                    ++c;
+                }
+                if (!is_same_query(overlaps[c], overlaps[i])) {
+                    remove_invalid_overlaps(c, i, false);
+                    c = i;
+                }
+            }
+            if (!status) {
+                remove_invalid_overlaps(c, overlaps.size(), false);
+                c = overlaps.size();
+            }
+
+            for (uint64_t i = l; i < c; ++i) {
+                if (overlaps[i] == nullptr) {
+                    continue;
+                }
+                if (target_status(overlaps[i]) != 1) {
+                    overlaps[i].reset();
+                    continue;
+                }
+                if (overlaps[i]->q_name().empty()) {
+                    queries_ids.emplace(static_cast<uint64_t>(overlaps[i]->q_id()) << 1 | 0);
+                } else {
+                    queries_names.emplace(overlaps[i]->q_name());
+                }
+            }
+
+            uint64_t n = shrinkToFit(overlaps, l);
+            l = c - n;
+
+            if (!status) {
+                break;
+            }
+        }
+
+        stop_phase("load_overlaps");
+
+        logger_->log("[racon::Polisher::initialize] loaded overlaps of target sequences");
+        logger_->log();
+    }
+
+    uint64_t sequences_size = 0, total_sequences_length = 0;
+
+    // preloaded sequences are borrowed only if they are used
+    bool is_preloaded = !preloaded_sequences_.empty();
+    std::vector<std::unique_ptr<Sequence>> chunk;
+
+    start_phase("load_sequences");
+
+    if (!is_preloaded) {
+        sparser_->reset();
+    }
+    while (true) {
+        auto status = is_preloaded ? false : sparser_->parse(chunk, kChunkSize);
+        auto& src = is_preloaded ? preloaded_sequences_ : chunk;
+
+        for (uint64_t i = 0; i < src.size(); ++i, ++sequences_size) {
+            total_sequences_length += src[i]->data().size();
+
+            auto it = name_to_id.find(src[i]->name() + "t");
+            if (it != name_to_id.end()) {
+                if (src[i]->data().size() != sequences_[it->second]->data().size() ||
+                    src[i]->quality().size() != sequences_[it->second]->quality().size()) {
+
+                    fprintf(stderr, "[racon::Polisher::initialize] error: "
+                        "duplicate sequence %s with unequal data\n",
+                        src[i]->name().c_str());
+                    exit(1);
+                }
+
+                name_to_id[src[i]->name() + "q"] = it->second;
+                id_to_id[sequences_size << 1 | 0] = it->second;
+            } else if (is_partial &&
+                queries_names.find(src[i]->name()) == queries_names.end() &&
+                queries_ids.find(sequences_size << 1 | 0) == queries_ids.end()) {
+                continue;
+            } else {
+                name_to_id[src[i]->name() + "q"] = sequences_.size();
+                id_to_id[sequences_size << 1 | 0] = sequences_.size();
+                if (is_preloaded) {
+                    borrowed_sequences_.emplace_back(sequences_.size(), i);
+                }
+                sequences_.emplace_back(std::move(src[i]));
+            }
+        }
+        chunk.clear();
+
+        if (!status) {
+            break;
+        }
+    }
+
+    if (sequences_size == 0) {
+        fprintf(stderr, "[racon::Polisher::initialize] error: "
+            "empty sequences set!\n");
+        exit(1);
+    }
+
+    std::unordered_set<std::string>().swap(queries_names);
+    std::unordered_set<uint64_t>().swap(queries_ids);
+
+    has_name.resize(sequences_.size(), false);
+    has_data.resize(sequences_.size(), false);
+    has_reverse_data.resize(sequences_.size(), false);
+
+    WindowType window_type = static_cast<double>(total_sequences_length) /
+        sequences_size <= 1000 ? WindowType::kNGS : WindowType::kTGS;
+
+    stop_phase("load_sequences");
+    metrics_->add("sequences", sequences_.size() - targets_size);
+
+    logger_->log("[racon::Polisher::initialize] loaded sequences");
+    logger_->log();
+
+    targets_coverages_.assign(targets_size, 0);
+
+    start_phase("load_overlaps");
+
+    // overlaps of partial target sets are already loaded
+    if (!is_partial) {
+        oparser_->reset();
+    }
+    uint64_t l = 0;
+    while (true) {
+        auto status = is_partial ? false : oparser_->parse(overlaps, kChunkSize);
+        if (!is_partial) {
+            metrics_->add("overlaps_parsed", overlaps.size() - l);
+        }
+
+        uint64_t c = l;
+        for (uint64_t i = l; i < overlaps.size(); ++i) {
+            overlaps[i]->transmute(sequences_, name_to_id, id_to_id);
+
+            if (!overlaps[i]->is_valid()) {
+                overlaps[i].reset();
+                continue;
+            }
+
+            while (overlaps[c] == nullptr) {
+                ++c;
+            }
+            if (overlaps[c]->q_id() != overlaps[i]->q_id()) {
+                remove_invalid_overlaps(c, i, true);
+                c = i;
+            }
+        }
+        if (!status) {
+            remove_invalid_overlaps(c, overlaps.size(), true);
+            c = overlaps.size();
+        }
+
+        for (uint64_t i = l; i < c; ++i) {
+            if (overlaps[i] == nullptr) {
+                continue;
+            }
+
+            ++targets_coverages_[overlaps[i]->t_id()];
+
+            if (!is_pending_overlap(overlaps[i])) {
+                overlaps[i].reset();
+                continue;
+            }
+
+            // segments failing the threshold would be dropped after alignment
+            if (is_quality_prefilter_ && overlaps[i]->estimate_quality(sequences_,
+                window_length_, 0.02 * window_length_) < quality_threshold_) {
+                overlaps[i].reset();
+                ++num_quality_overlaps;
+                continue;
+            }
+        }
+
+        uint64_t n = shrinkToFit(overlaps, l);
+        l = c - n;
+
+        if (!status) {
+            break;
+        }
+    }
+
+    std::unordered_map<std::string, uint64_t>().swap(name_to_id);
+    std::unordered_map<uint64_t, uint64_t>().swap(id_to_id);
+
+    // overlaps are accepted by decreasing identity, length and mapping
+    // quality while they span a pending window below the maximal coverage,
+    // the rest is never aligned
+    uint64_t num_coverage_overlaps = 0;
+    if (max_coverage_ != 0) {
+        std::vector<uint64_t> order(overlaps.size());
+        std::iota(order.begin(), order.end(), 0);
+        std::sort(order.begin(), order.end(), [&](uint64_t lhs, uint64_t rhs) -> bool {
+            const auto& l = overlaps[lhs];
+            const auto& r = overlaps[rhs];
+            if (l->identity() != r->identity()) {
+                return l->identity() > r->identity();
+            }
+            if (l->length() != r->length()) {
+                return l->length() > r->length();
+            }
+            if (l->mapping_quality() != r->mapping_quality()) {
+                return l->mapping_quality() > r->mapping_quality();
+            }
+            return lhs < rhs;
+        });
+
+        std::vector<std::vector<uint32_t>> coverages(targets_size);
+        for (uint64_t i = 0; i < targets_size; ++i) {
+            coverages[i].resize((sequences_[i]->data().size() + window_length_ - 1) /
+                window_length_, 0);
+        }
+
+        for (const auto& it: order) {
+            auto& coverage = coverages[overlaps[it]->t_id()];
+            uint64_t begin = overlaps[it]->t_begin() / window_length_;
+            uint64_t end = std::min<uint64_t>(coverage.size(),
+                (static_cast<uint64_t>(overlaps[it]->t_end()) + window_length_ - 1) /
+                window_length_);
+
+            bool is_needed = false;
+            for (uint64_t k = begin; k < end; ++k) {
+                if (coverage[k] < max_coverage_ && (is_pending_window.empty() ||
+                    is_pending_window[overlaps[it]->t_id()][k])) {
+                    is_needed = true;
+                    break;
+                }
+            }
+            if (!is_needed) {
+                overlaps[it].reset();
+                ++num_coverage_overlaps;
+                continue;
+            }
+            for (uint64_t k = begin; k < end; ++k) {
+                ++coverage[k];
+            }
+        }
+        shrinkToFit(overlaps, 0);
+    }
+
+    for (const auto& it: overlaps) {
+        if (it->strand()) {
+            has_reverse_data[it->q_id()] = true;
+        } else {
+            has_data[it->q_id()] = true;
+        }
+    }
+
+    if (overlaps.empty() && num_quality_overlaps == 0 && !is_partial &&
+        (checkpoint_ == nullptr || checkpoint_->size() == 0)) {
+        fprintf(stderr, "[racon::Polisher::initialize] error: "
+            "empty overlap set!\n");
+        exit(1);
+    }
+
+    stop_phase("load_overlaps");
+    metrics_->add("overlaps_filtered_error", num_error_overlaps);
+    metrics_->add("overlaps_filtered_self", num_self_overlaps);
+    metrics_->add("overlaps_filtered_duplicate", num_duplicate_overlaps);
+    metrics_->add("overlaps_filtered_quality", num_quality_overlaps);
+    metrics_->add("overlaps_filtered_coverage", num_coverage_overlaps);
+    metrics_->add("overlaps_used", overlaps.size());
+
+    // inputs are accounted as soon as they are loaded so that a batch over the
+    // budget is reported before windows are built
+    uint64_t sequences_bytes = numBytes(sequences_) + numBytes(preloaded_sequences_);
+    uint64_t overlaps_bytes = numBytes(overlaps);
+    metrics_->max("accounted_bytes_sequences", sequences_bytes);
+    metrics_->max("accounted_bytes_overlaps", overlaps_bytes);
+
+    bool is_over_budget = false;
+    auto check_budget = [&](uint64_t accounted_bytes) -> void {
+        if (max_memory_ == 0 || is_over_budget || accounted_bytes <= max_memory_) {
+            return;
+        }
+        is_over_budget = true;
+        fprintf(stderr, "[racon::Polisher::initialize] warning: "
+            "accounted memory of batch %lu (%lu bytes) exceeds the budget!\n",
+            num_batches_, accounted_bytes);
+    };
+    check_budget(sequences_bytes + overlaps_bytes);
+
+    logger_->log("[racon::Polisher::initialize] loaded overlaps");
+    logger_->log();
+
+    start_phase("prepare_sequences");
+
+    // reads are encoded once here for aligners working on codes
+    create_aligner_backends();
+    bool is_encoded = aligner_backends_.front()->uses_codes();
+
+    // borrowed sequences are returned to later jobs intact
+    std::vector<bool> is_borrowed(sequences_.size(), false);
+    for (const auto& it: borrowed_sequences_) {
+        is_borrowed[it.first] = true;
+    }
+
+    parallel_chunks(sequences_.size(), std::max<uint64_t>(1,
+        sequences_.size() / (thread_to_id_.size() * 16)),
+        [&](uint64_t begin, uint64_t end, uint32_t) -> void {
+            uint64_t trace_begin = tracer_->now();
+            for (uint64_t j = begin; j < end; ++j) {
+                if (is_encoded && (has_data[j] || has_reverse_data[j])) {
+                    sequences_[j]->encode();
+                }
+                sequences_[j]->transmute(has_name[j] || is_borrowed[j],
+                    has_data[j] || is_borrowed[j], has_reverse_data[j]);
+            }
+            tracer_->record("transmute_sequence", trace_begin);
+        });
+
+    stop_phase("prepare_sequences");
+
+    start_phase("align_overlaps");
+    find_overlap_breaking_points(overlaps);
+    for (const auto& it: sequences_) {
+        it->release_codes();
+    }
+    stop_phase("align_overlaps");
+
+    logger_->log();
+    start_phase("build_windows");
+
+    std::vector<uint64_t> id_to_first_window_id(targets_size + 1, 0);
+    for (uint64_t i = 0; i < targets_size; ++i) {
+        uint32_t k = 0;
+        for (uint32_t j = 0; j < sequences_[i]->data().size(); j += window_length_, ++k) {
+            if (!is_selected_window.empty() && !is_selected_window[i][k]) {
+                continue;
+            }
+
+            uint32_t length = std::min(j + window_length_,
+                static_cast<uint32_t>(sequences_[i]->data().size())) - j;
+
+            windows_.emplace_back(createWindow(i, k, window_type,
+                &(sequences_[i]->data()[j]), length,
+                sequences_[i]->quality().empty() ? &(dummy_quality_[0]) :
+                &(sequences_[i]->quality()[j]), length));
+        }
+
+        id_to_first_window_id[i + 1] = windows_.size();
+    }
+
+    auto find_window_id = [&](uint64_t id, uint32_t rank) -> int64_t {
+        if (is_selected_window.empty()) {
+            return id_to_first_window_id[id] + rank;
+        }
+        if (!is_selected_window[id][rank]) {
+            return -1;
+        }
+        auto it = std::lower_bound(windows_.begin() + id_to_first_window_id[id],
+            windows_.begin() + id_to_first_window_id[id + 1], rank,
+            [](const std::shared_ptr<Window>& window, uint32_t value) -> bool {
+                return window->rank() < value;
+            });
+        return it - windows_.begin();
+    };
+
+    for (uint64_t i = 0; i < overlaps.size(); ++i) {
+
+        const auto& sequence = sequences_[overlaps[i]->q_id()];
+        const auto& breaking_points = overlaps[i]->breaking_points();
+
+        for (uint32_t j = 0; j < breaking_points.size(); j += 2) {
+            if (breaking_points[j + 1].second - breaking_points[j].second < 0.02 * window_length_) {
+                continue;
+            }
+
+            int64_t window_id = find_window_id(overlaps[i]->t_id(),
+                breaking_points[j].first / window_length_);
+            if (window_id < 0) {
+                continue;
+            }
+
+            if (!sequence->quality().empty() ||
+                !sequence->reverse_quality().empty()) {
+
+                const auto& quality = overlaps[i]->strand() ?
                     sequence->reverse_quality() : sequence->quality();
                 double average_quality = 0;
                 for (uint32_t k = breaking_points[j].second; k < breaking_points[j + 1].second; ++k) {
@@ -428,8 +1200,6 @@ void Polisher::initialize() {
                 }
             }
 
-            uint64_t window_id = id_to_first_window_id[overlaps[i]->t_id()] +
-                breaking_points[j].first / window_length_;
             uint32_t window_start = (breaking_points[j].first / window_length_) *
                 window_length_;
 
@@ -456,95 +1226,648 @@ void Polisher::initialize() {
         overlaps[i].reset();
     }
 
+    uint64_t windows_bytes = windows_.capacity() * sizeof(std::shared_ptr<Window>);
+    for (const auto& it: windows_) {
+        metrics_->add_window(it->num_layers());
+        windows_bytes += it->num_bytes();
+    }
+    stop_phase("build_windows");
+
+    // overlaps are released while windows are built, the sum is an upper bound
+    uint64_t accounted_bytes = sequences_bytes + overlaps_bytes + windows_bytes;
+    metrics_->max("accounted_bytes_windows", windows_bytes);
+    metrics_->max("accounted_bytes", accounted_bytes);
+    check_budget(accounted_bytes);
+
+    if (max_memory_ != 0) {
+        // later batches are sized by the footprint of this one
+        if (memory_batch_size_ != 0 && batch_length != 0) {
+            uint64_t preloaded_bytes = numBytes(preloaded_sequences_);
+            double bytes_per_base = (accounted_bytes - preloaded_bytes) *
+                kMemoryOverhead / batch_length;
+            memory_batch_size_ = std::max<uint64_t>(1, (max_memory_ >
+                preloaded_bytes ? max_memory_ - preloaded_bytes : 0) / bytes_per_base);
+        }
+    }
+
     logger_->log("[racon::Polisher::initialize] transformed data into windows");
+
+    return true;
 }
 
 void Polisher::find_overlap_breaking_points(std::vector<std::unique_ptr<Overlap>>& overlaps)
 {
-    std::vector<std::future<void>> thread_futures;
-    for (uint64_t i = 0; i < overlaps.size(); ++i) {
-        thread_futures.emplace_back(thread_pool_->submit(
-            [&](uint64_t j) -> void {
-                overlaps[j]->find_breaking_points(sequences_, window_length_);
-            }, i));
-    }
+    create_aligner_backends();
+    uint32_t batch_size = aligner_backends_.front()->batch_size();
+
+    // overlaps the backend leaves without a cigar string are aligned with
+    // edlib while their breaking points are found
+    std::atomic<uint64_t> num_fallback_overlaps(0);
+    parallel_chunks(overlaps.size(), batch_size,
+        [&](uint64_t begin, uint64_t end, uint32_t thread_id) -> void {
+            uint64_t trace_begin = tracer_->now();
+            std::vector<Overlap*> batch;
+            for (uint64_t k = begin; k < end; ++k) {
+                batch.emplace_back(overlaps[k].get());
+            }
+            aligner_backends_[thread_id]->align(batch, sequences_);
+            uint64_t num_fallbacks = 0;
+            for (const auto& overlap: batch) {
+                num_fallbacks += overlap->cigar().empty() &&
+                    overlap->breaking_points().empty();
+                overlap->find_breaking_points(sequences_, window_length_);
+            }
+            num_fallback_overlaps += num_fallbacks;
+            tracer_->record(batch_size == 1 ? "align_overlap" : "batch_alignment",
+                trace_begin);
+        }, "[racon::Polisher::initialize] aligning overlaps",
+        "[racon::Polisher::initialize] aligned overlaps");
+
+    metrics_->add("overlaps_aligned_edlib_fallback", num_fallback_overlaps);
+
+    report_throughput();
+}
 
-    uint32_t logger_step = thread_futures.size() / 20;
-    for (uint64_t i = 0; i < thread_futures.size(); ++i) {
-        thread_futures[i].wait();
-        if (logger_step != 0 && (i + 1) % logger_step == 0 && (i + 1) / logger_step < 20) {
-            logger_->bar("[racon::Polisher::initialize] aligning overlaps");
+void Polisher::polish(std::vector<std::unique_ptr<Sequence>>& dst,
+    bool drop_unpolished_sequences) {
+
+    logger_->log();
+    start_phase("generate_consensus");
+
+    std::vector<bool> window_consensus_status(windows_.size(), false);
+
+    std::vector<uint64_t> window_ids;
+    for (uint64_t i = 0; i < windows_.size(); ++i) {
+        if (checkpoint_ != nullptr) {
+            bool is_polished = false;
+            if (checkpoint_->restore(sequences_[windows_[i]->id()]->name(),
+                *windows_[i], is_polished)) {
+
+                window_consensus_status[i] = is_polished;
+                continue;
+            }
         }
+        window_ids.emplace_back(i);
     }
-    if (logger_step != 0) {
-        logger_->bar("[racon::Polisher::initialize] aligning overlaps");
+
+    auto store = [&](uint64_t j, bool is_polished) -> void {
+        if (checkpoint_ != nullptr) {
+            checkpoint_->store(sequences_[windows_[j]->id()]->name(),
+                *windows_[j], is_polished);
+        }
+    };
+
+    create_consensus_backends(windows_.empty() ? WindowType::kTGS :
+        windows_.front()->type());
+    uint32_t batch_size = consensus_backends_.front()->batch_size();
+
+    // windows are written by different threads, hence bytes instead of bits
+    std::vector<uint8_t> is_polished(windows_.size(), 0);
+    auto generate_consensus = [&](const std::vector<uint64_t>& ids,
+        uint32_t thread_id) -> void {
+
+        std::vector<std::shared_ptr<Window>> batch;
+        for (const auto& it: ids) {
+            batch.emplace_back(windows_[it]);
+        }
+        std::vector<bool> batch_status;
+
+        uint64_t begin = tracer_->now();
+        consensus_backends_[thread_id]->generate_consensus(batch, batch_status);
+        tracer_->record(batch_size == 1 ? "window_consensus" : "batch_consensus",
+            begin);
+
+        for (uint32_t k = 0; k < ids.size(); ++k) {
+            is_polished[ids[k]] = batch_status[k];
+            store(ids[k], batch_status[k]);
+        }
+    };
+
+    if (!worker_to_node_.empty()) {
+        // windows are stored target by target, each target goes to the least
+        // loaded node so that its windows are polished by workers of one node
+        // (the windows stay where they were allocated)
+        uint32_t num_nodes = *std::max_element(worker_to_node_.begin(),
+            worker_to_node_.end()) + 1;
+        std::vector<uint64_t> window_targets_ids;
+        for (const auto& it: window_ids) {
+            window_targets_ids.emplace_back(windows_[it]->id());
+        }
+        auto node_window_ids = assignRuns(window_targets_ids, num_nodes);
+        for (auto& it: node_window_ids) {
+            for (auto& jt: it) {
+                jt = window_ids[jt];
+            }
+        }
+
+        // workers take windows of their own node first and help other nodes
+        // once it runs out of them
+        std::mutex mutex;
+        std::vector<uint64_t> node_next(num_nodes, 0);
+        auto next_window = [&](uint32_t thread_id, uint64_t& dst) -> bool {
+            std::lock_guard<std::mutex> lock(mutex);
+            for (uint32_t k = 0; k < num_nodes; ++k) {
+                uint32_t node = (worker_to_node_[thread_id] + k) % num_nodes;
+                if (node_next[node] < node_window_ids[node].size()) {
+                    dst = node_window_ids[node][node_next[node]++];
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        run_on_workers([&](uint32_t thread_id) -> void {
+            std::vector<uint64_t> batch_window_ids;
+            uint64_t j = 0;
+            while (true) {
+                batch_window_ids.clear();
+                while (batch_window_ids.size() < batch_size && next_window(thread_id, j)) {
+                    batch_window_ids.emplace_back(j);
+                }
+                if (batch_window_ids.empty()) {
+                    break;
+                }
+                generate_consensus(batch_window_ids, thread_id);
+            }
+        });
+
+        logger_->log("[racon::Polisher::polish] generated consensus");
     } else {
-        logger_->log("[racon::Polisher::initialize] aligned overlaps");
+        parallel_chunks(window_ids.size(), batch_size,
+            [&](uint64_t begin, uint64_t end, uint32_t thread_id) -> void {
+                generate_consensus(std::vector<uint64_t>(window_ids.begin() + begin,
+                    window_ids.begin() + end), thread_id);
+            }, "[racon::Polisher::polish] generating consensus",
+            "[racon::Polisher::polish] generated consensus");
+    }
+
+    for (const auto& it: window_ids) {
+        window_consensus_status[it] = is_polished[it];
     }
+
+    report_throughput();
+
+    stop_phase("generate_consensus");
+
+    collect_polished_sequences(dst, drop_unpolished_sequences,
+        window_consensus_status);
+
+    std::vector<std::shared_ptr<Window>>().swap(windows_);
+    release_sequences();
 }
 
-void Polisher::polish(std::vector<std::unique_ptr<Sequence>>& dst,
+void Polisher::release_sequences() {
+
+    for (const auto& it: borrowed_sequences_) {
+        preloaded_sequences_[it.second] = std::move(sequences_[it.first]);
+    }
+    borrowed_sequences_.clear();
+    std::vector<std::unique_ptr<Sequence>>().swap(sequences_);
+}
+
+void Polisher::run(const std::function<void(std::unique_ptr<Sequence>)>& callback,
     bool drop_unpolished_sequences) {
 
-    logger_->log();
+    while (initialize()) {
+        std::vector<std::unique_ptr<Sequence>> polished_sequences;
+        polish(polished_sequences, drop_unpolished_sequences);
 
-    std::vector<std::future<bool>> thread_futures;
-    for (uint64_t i = 0; i < windows_.size(); ++i) {
+        for (auto& it: polished_sequences) {
+            callback(std::move(it));
+        }
+    }
+}
+
+void Polisher::project_memory(double targets_length, double targets_bytes) {
+
+    if (targets_length == 0) {
+        return;
+    }
+
+    // reverse complements (and reversed qualities) are created on demand, so
+    // data and quality of each sequence are counted twice
+    auto count_bytes = [](const std::vector<std::unique_ptr<Sequence>>& src) -> double {
+        double dst = 0;
+        for (const auto& it: src) {
+            if (it != nullptr) {
+                dst += it->num_bytes() + it->data().size() + it->quality().size();
+            }
+        }
+        return dst;
+    };
+
+    uint64_t preloaded_bytes = numBytes(preloaded_sequences_);
+    double sequences_bytes = 0;
+    if (!preloaded_sequences_.empty()) {
+        sequences_bytes = count_bytes(preloaded_sequences_);
+    } else {
+        std::vector<std::unique_ptr<Sequence>> sequences;
+        double scale = sampleSource(*sparser_, sequences);
+        sequences_bytes = count_bytes(sequences) * scale;
+    }
+
+    // breaking points are added after alignment and are not projected
+    std::vector<std::unique_ptr<Overlap>> overlaps;
+    double scale = sampleSource(*oparser_, overlaps);
+    double overlaps_bytes = numBytes(overlaps) * scale;
+
+    // preloaded sequences stay in memory and are shared by all batches
+    uint64_t budget = max_memory_ > preloaded_bytes ? max_memory_ - preloaded_bytes : 0;
+    double projected_bytes = (sequences_bytes + overlaps_bytes + targets_bytes) *
+        kMemoryOverhead / num_shards_;
+    if (projected_bytes <= budget) {
+        memory_batch_size_ = 0;
+        return;
+    }
+
+    double bytes_per_base = projected_bytes * num_shards_ / targets_length;
+    memory_batch_size_ = std::max<uint64_t>(1, budget / bytes_per_base);
+
+    fprintf(stderr, "[racon::Polisher::initialize] projected memory footprint "
+        "(%.0f bytes) exceeds the budget, polishing in batches of %lu bases\n",
+        projected_bytes, memory_batch_size_);
+}
+
+void Polisher::enable_numa() {
+
+    auto nodes = numaNodes();
+    if (nodes.size() < 2) {
+        fprintf(stderr, "[racon::Polisher::enable_numa] warning: "
+            "less than two NUMA nodes available, ignoring NUMA placement!\n");
+        return;
+    }
+
+    // consecutive workers share a node, nodes get equal shares of workers
+    worker_to_node_ = assignWorkers(thread_to_id_.size(), nodes.size());
+    pin_workers(nodes);
+}
+
+void Polisher::pin_workers(const std::vector<std::vector<uint32_t>>& nodes) {
+
+    std::vector<uint8_t> is_pinned(thread_to_id_.size(), 0);
+    run_on_workers([&](uint32_t thread_id) -> void {
+        is_pinned[thread_id] = worker_to_node_[thread_id] < nodes.size() &&
+            pinThread(nodes[worker_to_node_[thread_id]]);
+    });
+    if (std::find(is_pinned.begin(), is_pinned.end(), 0) != is_pinned.end()) {
+        fprintf(stderr, "[racon::Polisher::pin_workers] warning: "
+            "unable to pin some threads to their NUMA nodes!\n");
+    }
+}
+
+void Polisher::restart_threads() {
+
+    // the pool can not be joined as its threads do not exist, hence it is
+    // leaked (the child exits after its job)
+    uint32_t num_threads = thread_to_id_.size();
+    thread_pool_.release();
+    thread_pool_ = thread_pool::createThreadPool(num_threads);
+
+    thread_to_id_.clear();
+    uint32_t id = 0;
+    for (const auto& it: thread_pool_->thread_identifiers()) {
+        thread_to_id_[it] = id++;
+    }
+
+    bool is_tracing = tracer_->is_enabled();
+    tracer_.reset(new Tracer(thread_pool_->thread_identifiers()));
+    if (is_tracing) {
+        tracer_->enable();
+    }
+
+    if (!worker_to_node_.empty()) {
+        pin_workers(numaNodes());
+    }
+}
+
+void Polisher::enable_prefetch(uint64_t max_bytes) {
+    if (prefetch_bytes_ != 0 || max_bytes == 0) {
+        return;
+    }
+    prefetch_bytes_ = max_bytes;
+    sparser_ = createPrefetchSource(std::move(sparser_), prefetch_bytes_);
+    oparser_ = createPrefetchSource(std::move(oparser_), prefetch_bytes_);
+    tparser_ = createPrefetchSource(std::move(tparser_), prefetch_bytes_);
+}
+
+void Polisher::enable_quality_prefilter() {
+    is_quality_prefilter_ = true;
+}
+
+void Polisher::set_max_coverage(uint32_t max_coverage) {
+    max_coverage_ = max_coverage;
+}
+
+void Polisher::enable_banded_alignment(uint32_t band_width) {
+    backend_parameters_.band_width = band_width;
+    set_consensus_backend(WindowType::kNGS, band_width == 0 ? "spoa" : "banded");
+    set_consensus_backend(WindowType::kTGS, band_width == 0 ? "spoa" : "banded");
+}
+
+void Polisher::enable_cpu_batches() {
+    set_consensus_backend(WindowType::kNGS, "batch");
+    set_consensus_backend(WindowType::kTGS, "batch");
+}
+
+void Polisher::enable_cpu_aligner() {
+    set_aligner_backend("batch");
+}
+
+void Polisher::set_consensus_backend(WindowType type, const std::string& name) {
+    if (!hasConsensusBackend(name)) {
+        fprintf(stderr, "[racon::Polisher::set_consensus_backend] error: "
+            "unknown backend %s!\n", name.c_str());
+        exit(1);
+    }
+    consensus_backends_names_[static_cast<uint32_t>(type)] = name;
+    consensus_backends_.clear();
+}
+
+void Polisher::set_aligner_backend(const std::string& name) {
+    if (!hasAlignerBackend(name)) {
+        fprintf(stderr, "[racon::Polisher::set_aligner_backend] error: "
+            "unknown backend %s!\n", name.c_str());
+        exit(1);
+    }
+    aligner_backend_name_ = name;
+    aligner_backends_.clear();
+}
+
+void Polisher::create_consensus_backends(WindowType type) {
+    const auto& name = consensus_backends_names_[static_cast<uint32_t>(type)];
+    if (!consensus_backends_.empty() && consensus_backends_.front()->name() == name) {
+        return;
+    }
+    report_throughput();
+    consensus_backends_.clear();
+    consensus_backends_.resize(thread_to_id_.size());
+    // pinned workers create (and preallocate) their own backends so that
+    // their memory is first touched on the workers' nodes
+    auto create = [&](uint32_t thread_id) -> void {
+        consensus_backends_[thread_id] = createConsensusBackend(name,
+            backend_parameters_);
+    };
+    if (!worker_to_node_.empty()) {
+        run_on_workers(create);
+    } else {
+        for (uint32_t i = 0; i < consensus_backends_.size(); ++i) {
+            create(i);
+        }
+    }
+}
+
+void Polisher::create_aligner_backends() {
+    if (!aligner_backends_.empty()) {
+        return;
+    }
+    aligner_backends_.resize(thread_to_id_.size());
+    auto create = [&](uint32_t thread_id) -> void {
+        aligner_backends_[thread_id] = createAlignerBackend(aligner_backend_name_,
+            backend_parameters_);
+    };
+    if (!worker_to_node_.empty()) {
+        run_on_workers(create);
+    } else {
+        for (uint32_t i = 0; i < aligner_backends_.size(); ++i) {
+            create(i);
+        }
+    }
+}
+
+template<typename T>
+static void reportThroughput(Metrics& metrics, const std::string& prefix,
+    const char* items, const std::vector<std::unique_ptr<T>>& backends) {
+
+    for (const auto& it: backends) {
+        auto throughput = it->take_throughput();
+        if (throughput.num_items == 0) {
+            continue;
+        }
+        std::string name = prefix + it->name() + "_";
+        metrics.add(name + items, throughput.num_items);
+        metrics.add(name + "bases", throughput.num_bases);
+        metrics.add(name + "nanoseconds", throughput.num_nanoseconds);
+    }
+}
+
+void Polisher::report_throughput() {
+    reportThroughput(*metrics_, "consensus_backend_", "windows", consensus_backends_);
+    reportThroughput(*metrics_, "aligner_backend_", "overlaps", aligner_backends_);
+}
+
+void Polisher::run_on_workers(const std::function<void(uint32_t)>& task) {
+
+    // each task waits until all of them have started, which guarantees that
+    // every worker thread gets exactly one
+    std::mutex mutex;
+    std::condition_variable condition;
+    uint32_t num_started = 0;
+    uint32_t num_threads = thread_to_id_.size();
+
+    std::vector<std::future<void>> thread_futures;
+    for (uint32_t i = 0; i < num_threads; ++i) {
         thread_futures.emplace_back(thread_pool_->submit(
-            [&](uint64_t j) -> bool {
+            [&]() -> void {
                 auto it = thread_to_id_.find(std::this_thread::get_id());
                 if (it == thread_to_id_.end()) {
-                    fprintf(stderr, "[racon::Polisher::polish] error: "
+                    fprintf(stderr, "[racon::Polisher::run_on_workers] error: "
                         "thread identifier not present!\n");
                     exit(1);
                 }
-                return windows_[j]->generate_consensus(
-                    alignment_engines_[it->second], trim_);
-            }, i));
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (++num_started == num_threads) {
+                        condition.notify_all();
+                    } else {
+                        condition.wait(lock, [&] () -> bool {
+                            return num_started == num_threads;
+                        });
+                    }
+                }
+                task(it->second);
+            }));
+    }
+    for (const auto& it: thread_futures) {
+        it.wait();
     }
+}
 
-    std::string polished_data = "";
-    uint32_t num_polished_windows = 0;
+void Polisher::parallel_chunks(uint64_t size, uint64_t chunk_size,
+    const std::function<void(uint64_t, uint64_t, uint32_t)>& task,
+    const char* bar_message, const char* log_message) {
 
-    uint64_t logger_step = thread_futures.size() / 20;
+    if (size == 0) {
+        return;
+    }
+    chunk_size = std::max<uint64_t>(chunk_size, 1);
+    uint64_t num_chunks = (size + chunk_size - 1) / chunk_size;
+    uint32_t num_tasks = std::min<uint64_t>(num_chunks, thread_to_id_.size());
 
-    for (uint64_t i = 0; i < thread_futures.size(); ++i) {
-        thread_futures[i].wait();
+    // one task per worker claims chunks until none are left, finished ones
+    // are counted only for the progress bar
+    std::atomic<uint64_t> next_chunk(0);
+    std::mutex mutex;
+    std::condition_variable condition;
+    uint64_t num_finished = 0;
 
-        num_polished_windows += thread_futures[i].get() == true ? 1 : 0;
-        polished_data += windows_[i]->consensus();
+    std::vector<std::future<void>> thread_futures;
+    for (uint32_t i = 0; i < num_tasks; ++i) {
+        thread_futures.emplace_back(thread_pool_->submit(
+            [&]() -> void {
+                auto it = thread_to_id_.find(std::this_thread::get_id());
+                if (it == thread_to_id_.end()) {
+                    fprintf(stderr, "[racon::Polisher::parallel_chunks] error: "
+                        "thread identifier not present!\n");
+                    exit(1);
+                }
+                for (uint64_t j = next_chunk++; j < num_chunks; j = next_chunk++) {
+                    task(j * chunk_size, std::min(size, (j + 1) * chunk_size),
+                        it->second);
+                    if (bar_message != nullptr) {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        ++num_finished;
+                        condition.notify_one();
+                    }
+                }
+            }));
+    }
 
-        if (i == windows_.size() - 1 || windows_[i + 1]->rank() == 0) {
-            double polished_ratio = num_polished_windows /
-                static_cast<double>(windows_[i]->rank() + 1);
+    if (bar_message != nullptr) {
+        uint64_t logger_step = num_chunks / 20;
+        for (uint64_t i = 1; logger_step != 0 && i < 20; ++i) {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&] () -> bool {
+                return num_finished >= i * logger_step;
+            });
+            lock.unlock();
+            logger_->bar(bar_message);
+        }
+        for (const auto& it: thread_futures) {
+            it.wait();
+        }
+        if (logger_step != 0) {
+            logger_->bar(bar_message);
+        } else if (log_message != nullptr) {
+            logger_->log(log_message);
+        }
+        return;
+    }
 
-            if (!drop_unpolished_sequences || polished_ratio > 0) {
-                std::string tags = type_ == PolisherType::kF ? "r" : "";
-                tags += " LN:i:" + std::to_string(polished_data.size());
-                tags += " RC:i:" + std::to_string(targets_coverages_[windows_[i]->id()]);
-                tags += " XC:f:" + std::to_string(polished_ratio);
-                dst.emplace_back(createSequence(sequences_[windows_[i]->id()]->name() +
-                    tags, polished_data));
+    for (const auto& it: thread_futures) {
+        it.wait();
+    }
+}
+
+void Polisher::parallel_for(uint64_t size,
+    const std::function<void(uint64_t, uint32_t)>& task) {
+
+    parallel_chunks(size, size / (thread_to_id_.size() * 4),
+        [&](uint64_t begin, uint64_t end, uint32_t thread_id) -> void {
+            for (uint64_t i = begin; i < end; ++i) {
+                task(i, thread_id);
             }
+        });
+}
+
+void Polisher::start_phase(const char* phase) {
+    metrics_->start(phase);
+    tracer_->start(phase);
+}
+
+void Polisher::stop_phase(const char* phase) {
+    tracer_->stop(phase);
+    metrics_->stop(phase);
+}
+
+void Polisher::collect_polished_sequences(std::vector<std::unique_ptr<Sequence>>& dst,
+    bool drop_unpolished_sequences, const std::vector<bool>& window_consensus_status) {
+
+    struct Segment {
+        uint64_t target_id;
+        uint64_t offset;
+        const char* data;
+        uint64_t length;
+    };
+
+    // windows are sorted by target and rank, missing ones are filled with the
+    // unpolished target data (i.e. windows outside of given regions) and do
+    // not count towards the polished ratio, targets without windows are
+    // output unchanged; output lengths are known once all windows are
+    // finished so that segments can be copied in parallel into preallocated
+    // sequences
+    std::vector<Segment> segments;
+    std::vector<std::string> polished_data(targets_coverages_.size());
+    std::vector<double> polished_ratios(targets_coverages_.size(), 0);
+    std::vector<bool> is_dropped(targets_coverages_.size(), false);
+    uint64_t num_polished = 0, num_unpolished = 0;
+
+    for (uint64_t i = 0, j = 0; i < targets_coverages_.size(); ++i) {
+        const auto& data = sequences_[i]->data();
+        if (data.empty()) {
+            continue;
+        }
 
-            num_polished_windows = 0;
-            polished_data.clear();
+        uint64_t begin = segments.size(), polished_length = 0, first_window_id = j;
+        uint32_t num_windows = 0, num_polished_windows = 0;
+
+        for (uint64_t k = 0; k < data.size(); k += window_length_, ++num_windows) {
+            if (j < windows_.size() && windows_[j]->id() == i &&
+                windows_[j]->rank() == num_windows) {
+
+                num_polished_windows += window_consensus_status[j] == true ? 1 : 0;
+                const auto& consensus = windows_[j]->consensus();
+                segments.push_back({i, polished_length, consensus.c_str(),
+                    consensus.size()});
+                ++j;
+            } else {
+                segments.push_back({i, polished_length, &data[k],
+                    std::min<uint64_t>(window_length_, data.size() - k)});
+            }
+            polished_length += segments.back().length;
         }
-        windows_[i].reset();
 
-        if (logger_step != 0 && (i + 1) % logger_step == 0 && (i + 1) / logger_step < 20) {
-            logger_->bar("[racon::Polisher::polish] generating consensus");
+        uint64_t num_selected_windows = j - first_window_id;
+        polished_ratios[i] = num_selected_windows == 0 ? 0 :
+            num_polished_windows / static_cast<double>(num_selected_windows);
+        num_polished += num_polished_windows;
+        num_unpolished += num_selected_windows - num_polished_windows;
+
+        is_dropped[i] = drop_unpolished_sequences && num_selected_windows != 0 &&
+            num_polished_windows == 0;
+        if (!is_dropped[i]) {
+            polished_data[i].resize(polished_length);
+        } else {
+            segments.resize(begin);
         }
     }
 
-    if (logger_step != 0) {
-        logger_->bar("[racon::Polisher::polish] generating consensus");
-    } else {
-        logger_->log("[racon::Polisher::polish] generated consensus");
+    metrics_->add("windows_polished", num_polished);
+    metrics_->add("windows_unpolished", num_unpolished);
+
+    parallel_for(segments.size(), [&](uint64_t j, uint32_t) -> void {
+        const auto& it = segments[j];
+        std::copy(it.data, it.data + it.length,
+            &polished_data[it.target_id][it.offset]);
+    });
+    for (auto& it: windows_) {
+        it.reset();
     }
 
-    std::vector<std::shared_ptr<Window>>().swap(windows_);
-    std::vector<std::unique_ptr<Sequence>>().swap(sequences_);
+    for (uint64_t i = 0; i < targets_coverages_.size(); ++i) {
+        if (sequences_[i]->data().empty() || is_dropped[i]) {
+            continue;
+        }
+
+        std::string tags = type_ == PolisherType::kF ? "r" : "";
+        tags += " LN:i:" + std::to_string(polished_data[i].size());
+        tags += " RC:i:" + std::to_string(targets_coverages_[i]);
+        tags += " XC:f:" + std::to_string(polished_ratios[i]);
+        if (num_shards_ > 1) {
+            tags += " TI:i:" + std::to_string(targets_ids_[i]);
+        }
+        dst.emplace_back(createSequence(sequences_[i]->name() + tags,
+            std::move(polished_data[i])));
+    }
 }
 
 }
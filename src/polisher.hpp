@@ -7,31 +7,33 @@
 #pragma once
 
 #include <stdlib.h>
+#include <string>
 #include <vector>
 #include <memory>
+#include <functional>
 #include <unordered_map>
+#include <unordered_set>
 #include <thread>
+#include <utility>
 
-namespace bioparser {
-    template<class T>
-    class Parser;
-}
+#include "source.hpp"
+#include "metrics.hpp"
+#include "tracer.hpp"
+#include "backend.hpp"
 
 namespace thread_pool {
     class ThreadPool;
 }
 
-namespace spoa {
-    class AlignmentEngine;
-}
-
-
 namespace racon {
 
 class Sequence;
 class Overlap;
 class Window;
 class Logger;
+class Checkpoint;
+
+enum class WindowType;
 
 enum class PolisherType {
     kC, // Contig polishing
@@ -45,56 +47,270 @@ std::unique_ptr<Polisher> createPolisher(const std::string& sequences_path,
     double error_threshold, bool trim, int8_t match, int8_t mismatch, int8_t gap,
     uint32_t num_threads, uint32_t cuda_batches = 0,
     bool cuda_banded_alignment = false, uint32_t cudaaligner_batches = 0,
-    uint32_t cudaaligner_band_width = 0);
+    uint32_t cudaaligner_band_width = 0, const std::string& regions_path = "",
+    const std::string& checkpoint_directory = "", uint32_t shard_id = 0,
+    uint32_t num_shards = 1, uint64_t batch_size = 0, uint64_t max_memory = 0);
+
+/*!
+ * @brief Creates a polisher from sequences, overlaps and target sequences
+ * held by the caller (spans have to outlive it); sequences are copied once
+ * at creation and reused by all batches, overlaps and targets are copied
+ * as they are parsed
+ */
+std::unique_ptr<Polisher> createPolisher(const SequenceSpan* sequences,
+    uint64_t num_sequences, const OverlapSpan* overlaps, uint64_t num_overlaps,
+    const SequenceSpan* targets, uint64_t num_targets, PolisherType type,
+    uint32_t window_length, double quality_threshold, double error_threshold,
+    bool trim, int8_t match, int8_t mismatch, int8_t gap, uint32_t num_threads,
+    uint64_t batch_size = 0);
 
 class Polisher {
 public:
     virtual ~Polisher();
 
-    virtual void initialize();
+    /*!
+     * @brief Loads the next batch of target sequences (all of them if the
+     * batch size is 0) and returns false if there are none left
+     */
+    virtual bool initialize();
 
     virtual void polish(std::vector<std::unique_ptr<Sequence>>& dst,
         bool drop_unpolished_sequences);
 
+    /*!
+     * @brief Parses all sequences once and keeps them in memory so that they
+     * can be reused by subsequent jobs (see reset)
+     */
+    void preload_sequences();
+
+    /*!
+     * @brief Replaces overlaps and target sequences with new ones, returns
+     * false if a file is not readable or has an unsupported format extension;
+     * regions and shards given at creation apply to the first job only
+     */
+    bool reset(const std::string& overlaps_path, const std::string& target_path);
+    bool reset(const OverlapSpan* overlaps, uint64_t num_overlaps,
+        const SequenceSpan* targets, uint64_t num_targets);
+
+    /*!
+     * @brief Initializes and polishes all remaining batches of target
+     * sequences, polished sequences are passed to the callback after each one
+     */
+    void run(const std::function<void(std::unique_ptr<Sequence>)>& callback,
+        bool drop_unpolished_sequences);
+
+    /*!
+     * @brief Timings and counters accumulated over all batches and jobs
+     */
+    const Metrics& metrics() const {
+        return *metrics_;
+    }
+
+    /*!
+     * @brief Starts sampling the peak memory of phases (see Metrics::enable)
+     */
+    void enable_metrics() {
+        metrics_->enable();
+    }
+
+    /*!
+     * @brief Starts recording a timeline of thread pool tasks and phases
+     */
+    void enable_tracing() {
+        tracer_->enable();
+    }
+
+    const Tracer& tracer() const {
+        return *tracer_;
+    }
+
+    /*!
+     * @brief Pins worker threads to NUMA nodes, which create their backends
+     * there, and polishes windows of each target with workers of a single
+     * node; windows themselves are not placed on nodes (no effect on machines
+     * with one node)
+     */
+    void enable_numa();
+
+    /*!
+     * @brief Replaces the thread pool in a forked child process, which has
+     * none of its parent's worker threads (workers are pinned again if NUMA
+     * placement is enabled)
+     */
+    void restart_threads();
+
+    /*!
+     * @brief Restricts partial order alignment on the CPU to a band of the
+     * given width around the expected diagonal (0 disables banding)
+     */
+    void enable_banded_alignment(uint32_t band_width);
+
+    /*!
+     * @brief Generates consensus of several windows at once per thread (see
+     * CPUBatchProcessor), banded alignment is not used in this mode
+     */
+    void enable_cpu_batches();
+
+    /*!
+     * @brief Aligns several overlaps at once per thread (see CPUBatchAligner),
+     * overlaps it skips are aligned with edlib
+     */
+    void enable_cpu_aligner();
+
+    /*!
+     * @brief Selects the registered backend (see backend.hpp) which generates
+     * consensus of windows of the given type (spoa by default)
+     */
+    void set_consensus_backend(WindowType type, const std::string& name);
+
+    /*!
+     * @brief Selects the registered backend which aligns overlaps (edlib by
+     * default)
+     */
+    void set_aligner_backend(const std::string& name);
+
+    /*!
+     * @brief Parses sequences, overlaps and targets on dedicated I/O threads
+     * (see createPrefetchSource), each of which keeps at most max_bytes of
+     * them ahead, so that the next batch is read while the current one is
+     * polished
+     */
+    void enable_prefetch(uint64_t max_bytes);
+
+    /*!
+     * @brief Skips alignment of overlaps none of whose segments is estimated
+     * to reach the quality threshold (see Overlap::estimate_quality)
+     */
+    void enable_quality_prefilter();
+
+    /*!
+     * @brief Aligns only the best overlaps (by identity, length and mapping
+     * quality) of each target window until it reaches max_coverage, instead
+     * of subsampling sequences beforehand (0 disables the cap)
+     */
+    void set_max_coverage(uint32_t max_coverage);
+
     friend std::unique_ptr<Polisher> createPolisher(const std::string& sequences_path,
         const std::string& overlaps_path, const std::string& target_path,
         PolisherType type, uint32_t window_length, double quality_threshold,
         double error_threshold, bool trim, int8_t match, int8_t mismatch, int8_t gap,
         uint32_t num_threads, uint32_t cuda_batches, bool cuda_banded_alignment,
-        uint32_t cudaaligner_batches, uint32_t cudaaligner_band_width);
+        uint32_t cudaaligner_batches, uint32_t cudaaligner_band_width,
+        const std::string& regions_path, const std::string& checkpoint_directory,
+        uint32_t shard_id, uint32_t num_shards, uint64_t batch_size,
+        uint64_t max_memory);
+    friend std::unique_ptr<Polisher> createPolisher(const SequenceSpan* sequences,
+        uint64_t num_sequences, const OverlapSpan* overlaps, uint64_t num_overlaps,
+        const SequenceSpan* targets, uint64_t num_targets, PolisherType type,
+        uint32_t window_length, double quality_threshold, double error_threshold,
+        bool trim, int8_t match, int8_t mismatch, int8_t gap, uint32_t num_threads,
+        uint64_t batch_size);
 
 protected:
-    Polisher(std::unique_ptr<bioparser::Parser<Sequence>> sparser,
-        std::unique_ptr<bioparser::Parser<Overlap>> oparser,
-        std::unique_ptr<bioparser::Parser<Sequence>> tparser,
+    Polisher(std::unique_ptr<Source<Sequence>> sparser,
+        std::unique_ptr<Source<Overlap>> oparser,
+        std::unique_ptr<Source<Sequence>> tparser,
         PolisherType type, uint32_t window_length, double quality_threshold,
         double error_threshold, bool trim, int8_t match, int8_t mismatch, int8_t gap,
-        uint32_t num_threads);
+        uint32_t num_threads, const std::string& regions_path,
+        std::unique_ptr<Checkpoint> checkpoint, uint32_t shard_id,
+        uint32_t num_shards, uint64_t batch_size, uint64_t max_memory);
     Polisher(const Polisher&) = delete;
     const Polisher& operator=(const Polisher&) = delete;
     virtual void find_overlap_breaking_points(std::vector<std::unique_ptr<Overlap>>& overlaps);
+    bool reset(std::unique_ptr<Source<Overlap>> oparser,
+        std::unique_ptr<Source<Sequence>> tparser);
+    void load_regions();
+    // frees sequences_, borrowed preloaded sequences are returned instead
+    void release_sequences();
+    void collect_polished_sequences(std::vector<std::unique_ptr<Sequence>>& dst,
+        bool drop_unpolished_sequences, const std::vector<bool>& window_consensus_status);
+    void project_memory(double targets_length, double targets_bytes);
+    void start_phase(const char* phase);
+    void stop_phase(const char* phase);
+    void pin_workers(const std::vector<std::vector<uint32_t>>& nodes);
+    // runs task once on every worker thread, passing its identifier
+    void run_on_workers(const std::function<void(uint32_t)>& task);
+    /*!
+     * @brief Runs task(begin, end, thread_id) on consecutive chunks of
+     * [0, size) which idle workers claim in order, and returns once all of
+     * them are done; if bar_message is given a progress bar is printed,
+     * followed by log_message if there are too few chunks for one
+     */
+    void parallel_chunks(uint64_t size, uint64_t chunk_size,
+        const std::function<void(uint64_t, uint64_t, uint32_t)>& task,
+        const char* bar_message = nullptr, const char* log_message = nullptr);
+    // runs task(i, thread_id) for every i in [0, size), splitting the range
+    // into a few chunks per worker
+    void parallel_for(uint64_t size,
+        const std::function<void(uint64_t, uint32_t)>& task);
+    // creates backends of every thread unless they are already selected
+    void create_consensus_backends(WindowType type);
+    void create_aligner_backends();
+    // adds throughput of all backends to metrics, counters are named by
+    // backend
+    void report_throughput();
 
-    std::unique_ptr<bioparser::Parser<Sequence>> sparser_;
-    std::unique_ptr<bioparser::Parser<Overlap>> oparser_;
-    std::unique_ptr<bioparser::Parser<Sequence>> tparser_;
+    std::unique_ptr<Source<Sequence>> sparser_;
+    std::unique_ptr<Source<Overlap>> oparser_;
+    std::unique_ptr<Source<Sequence>> tparser_;
 
     PolisherType type_;
     double quality_threshold_;
     double error_threshold_;
     bool trim_;
-    std::vector<std::shared_ptr<spoa::AlignmentEngine>> alignment_engines_;
+    BackendParameters backend_parameters_;
+    // indexed by window type
+    std::vector<std::string> consensus_backends_names_;
+    std::string aligner_backend_name_;
+    // one per thread
+    std::vector<std::unique_ptr<ConsensusBackend>> consensus_backends_;
+    std::vector<std::unique_ptr<AlignerBackend>> aligner_backends_;
 
     std::vector<std::unique_ptr<Sequence>> sequences_;
+    std::vector<std::unique_ptr<Sequence>> preloaded_sequences_;
+    // preloaded sequences moved into sequences_ for the current job, as
+    // pairs of indices into sequences_ and preloaded_sequences_
+    std::vector<std::pair<uint64_t, uint64_t>> borrowed_sequences_;
+    std::vector<uint64_t> targets_ids_;
     std::vector<uint32_t> targets_coverages_;
     std::string dummy_quality_;
 
     uint32_t window_length_;
     std::vector<std::shared_ptr<Window>> windows_;
 
+    std::string regions_path_;
+    std::unordered_map<std::string, std::vector<std::pair<uint32_t, uint32_t>>> regions_;
+
+    std::unique_ptr<Checkpoint> checkpoint_;
+
+    uint32_t shard_id_;
+    uint32_t num_shards_;
+
+    uint64_t batch_size_;
+    // bytes parsed ahead per input (0 disables prefetching)
+    uint64_t prefetch_bytes_;
+    bool is_quality_prefilter_;
+    // planned number of overlaps per window (0 disables the cap)
+    uint32_t max_coverage_;
+    // targets are split into batches of memory_batch_size_ if the projected
+    // footprint exceeds max_memory_ (both in bytes)
+    uint64_t max_memory_;
+    uint64_t memory_batch_size_;
+    uint64_t num_targets_;
+    uint64_t num_batches_;
+    bool has_remaining_targets_;
+    std::vector<uint64_t> shards_lengths_;
+    std::unordered_set<std::string> targets_names_;
+
     std::unique_ptr<thread_pool::ThreadPool> thread_pool_;
     std::unordered_map<std::thread::id, uint32_t> thread_to_id_;
+    // NUMA node of each worker thread (empty if NUMA is disabled)
+    std::vector<uint32_t> worker_to_node_;
 
     std::unique_ptr<Logger> logger_;
+    std::unique_ptr<Metrics> metrics_;
+    std::unique_ptr<Tracer> tracer_;
 };
 
 }
@@ -6,6 +6,7 @@
 
 #include <ctype.h>
 
+#include "alphabet.hpp"
 #include "sequence.hpp"
 
 namespace racon {
@@ -16,10 +17,16 @@ std::unique_ptr<Sequence> createSequence(const std::string& name,
     return std::unique_ptr<Sequence>(new Sequence(name, data));
 }
 
+std::unique_ptr<Sequence> createSequence(const std::string& name,
+    std::string&& data) {
+
+    return std::unique_ptr<Sequence>(new Sequence(name, std::move(data)));
+}
+
 Sequence::Sequence(const char* name, uint32_t name_length, const char* data,
     uint32_t data_length)
         : name_(name, name_length), data_(), reverse_complement_(), quality_(),
-        reverse_quality_() {
+        reverse_quality_(), codes_() {
 
     data_.reserve(data_length);
     for (uint32_t i = 0; i < data_length; ++i) {
@@ -43,7 +50,23 @@ Sequence::Sequence(const char* name, uint32_t name_length, const char* data,
 
 Sequence::Sequence(const std::string& name, const std::string& data)
     : name_(name), data_(data), reverse_complement_(), quality_(),
-    reverse_quality_() {
+    reverse_quality_(), codes_() {
+}
+
+Sequence::Sequence(const std::string& name, std::string&& data)
+    : name_(name), data_(std::move(data)), reverse_complement_(), quality_(),
+    reverse_quality_(), codes_() {
+}
+
+std::unique_ptr<Sequence> Sequence::clone() const {
+
+    auto sequence = std::unique_ptr<Sequence>(new Sequence(name_, data_));
+    sequence->reverse_complement_ = reverse_complement_;
+    sequence->quality_ = quality_;
+    sequence->reverse_quality_ = reverse_quality_;
+    sequence->codes_ = codes_;
+
+    return sequence;
 }
 
 void Sequence::create_reverse_complement() {
@@ -99,4 +122,20 @@ void Sequence::transmute(bool has_name, bool has_data, bool has_reverse_data) {
     }
 }
 
+void Sequence::encode() {
+
+    if (!codes_.empty()) {
+        return;
+    }
+
+    codes_.reserve(data_.size());
+    for (const auto& it: data_) {
+        codes_.emplace_back(encodeBase(it));
+    }
+}
+
+void Sequence::release_codes() {
+    std::vector<uint8_t>().swap(codes_);
+}
+
 }
@@ -24,6 +24,8 @@ namespace racon {
 class Sequence;
 std::unique_ptr<Sequence> createSequence(const std::string& name,
     const std::string& data);
+std::unique_ptr<Sequence> createSequence(const std::string& name,
+    std::string&& data);
 
 class Sequence {
 public:
@@ -49,20 +51,46 @@ public:
         return reverse_quality_;
     }
 
+    // data encoded with encodeBase, empty unless encode() was called
+    const std::vector<uint8_t>& codes() const {
+        return codes_;
+    }
+
+    std::unique_ptr<Sequence> clone() const;
+
+    // approximate memory footprint
+    uint64_t num_bytes() const {
+        return sizeof(Sequence) + name_.capacity() + data_.capacity() +
+            reverse_complement_.capacity() + quality_.capacity() +
+            reverse_quality_.capacity() + codes_.capacity();
+    }
+
     void create_reverse_complement();
 
     void transmute(bool has_name, bool has_data, bool has_reverse_data);
 
+    /*!
+     * @brief Encodes data once so that aligners can compare codes of both
+     * strands directly, codes outlive data dropped by transmute
+     */
+    void encode();
+
+    void release_codes();
+
     friend bioparser::FastaParser<Sequence>;
     friend bioparser::FastqParser<Sequence>;
+    friend class SequenceSpanSource;
     friend std::unique_ptr<Sequence> createSequence(const std::string& name,
         const std::string& data);
+    friend std::unique_ptr<Sequence> createSequence(const std::string& name,
+        std::string&& data);
 private:
     Sequence(const char* name, uint32_t name_length, const char* data,
         uint32_t data_length);
     Sequence(const char* name, uint32_t name_length, const char* data,
         uint32_t data_length, const char* quality, uint32_t quality_length);
     Sequence(const std::string& name, const std::string& data);
+    Sequence(const std::string& name, std::string&& data);
     Sequence(const Sequence&) = delete;
     const Sequence& operator=(const Sequence&) = delete;
 
@@ -71,6 +99,7 @@ private:
     std::string reverse_complement_;
     std::string quality_;
     std::string reverse_quality_;
+    std::vector<uint8_t> codes_;
 };
 
 }
@@ -0,0 +1,195 @@
+/*!
+ * @file server.cpp
+ *
+ * @brief Server class source file
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#include "sequence.hpp"
+#include "polisher.hpp"
+#include "server.hpp"
+
+namespace racon {
+
+constexpr uint32_t kMaxRequestLength = 64 * 1024;
+// exit status of a job which already reported its error to the client
+constexpr int32_t kReportedError = 2;
+
+static bool sendAll(int32_t connection, const std::string& data) {
+
+    uint64_t i = 0;
+    while (i < data.size()) {
+        auto n = send(connection, data.data() + i, data.size() - i, MSG_NOSIGNAL);
+        if (n <= 0) {
+            return false;
+        }
+        i += n;
+    }
+    return true;
+}
+
+std::unique_ptr<Server> createServer(const std::string& socket_path,
+    std::unique_ptr<Polisher> polisher, bool drop_unpolished_sequences) {
+
+    struct sockaddr_un address;
+    memset(&address, 0, sizeof(address));
+    address.sun_family = AF_UNIX;
+
+    if (socket_path.empty() || socket_path.size() >= sizeof(address.sun_path)) {
+        fprintf(stderr, "[racon::createServer] error: "
+            "invalid socket path %s!\n", socket_path.c_str());
+        exit(1);
+    }
+    strncpy(address.sun_path, socket_path.c_str(), sizeof(address.sun_path) - 1);
+
+    // remove a stale socket of a previous server
+    struct stat status;
+    if (stat(socket_path.c_str(), &status) == 0 && S_ISSOCK(status.st_mode)) {
+        unlink(socket_path.c_str());
+    }
+
+    // only the owner can submit jobs
+    mode_t mask = umask(S_IRWXG | S_IRWXO | S_IXUSR);
+    int32_t socket_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    bool is_bound = socket_fd >= 0 && bind(socket_fd,
+        reinterpret_cast<struct sockaddr*>(&address), sizeof(address)) == 0;
+    umask(mask);
+
+    if (!is_bound || chmod(socket_path.c_str(), S_IRUSR | S_IWUSR) != 0 ||
+        listen(socket_fd, 16) != 0) {
+
+        fprintf(stderr, "[racon::createServer] error: "
+            "unable to listen on socket %s!\n", socket_path.c_str());
+        exit(1);
+    }
+
+    return std::unique_ptr<Server>(new Server(socket_fd, socket_path,
+        std::move(polisher), drop_unpolished_sequences));
+}
+
+Server::Server(int32_t socket, const std::string& socket_path,
+    std::unique_ptr<Polisher> polisher, bool drop_unpolished_sequences)
+        : socket_(socket), socket_path_(socket_path),
+        polisher_(std::move(polisher)),
+        drop_unpolished_sequences_(drop_unpolished_sequences) {
+}
+
+Server::~Server() {
+    close(socket_);
+    unlink(socket_path_.c_str());
+}
+
+void Server::run() {
+
+    fprintf(stderr, "[racon::Server::run] listening on %s\n", socket_path_.c_str());
+
+    while (true) {
+        int32_t connection = accept(socket_, nullptr, nullptr);
+        if (connection < 0) {
+            continue;
+        }
+
+        bool is_running = process(connection);
+        close(connection);
+
+        if (!is_running) {
+            break;
+        }
+    }
+
+    fprintf(stderr, "[racon::Server::run] shut down\n");
+}
+
+bool Server::process(int32_t connection) {
+
+    // a request is a single line, either 'shutdown' or paths to overlaps and
+    // target sequences separated by a tab
+    std::string request;
+    char c;
+    while (request.size() < kMaxRequestLength && recv(connection, &c, 1, 0) == 1 &&
+        c != '\n') {
+        request += c;
+    }
+    if (!request.empty() && request.back() == '\r') {
+        request.pop_back();
+    }
+
+    if (request == "shutdown") {
+        sendAll(connection, "ok\n");
+        return false;
+    }
+
+    auto tab = request.find('\t');
+    if (tab == std::string::npos || request.find('\t', tab + 1) != std::string::npos) {
+        sendAll(connection, "error: invalid request!\n");
+        return true;
+    }
+
+    std::string overlaps_path = request.substr(0, tab);
+    std::string target_path = request.substr(tab + 1);
+
+    // each job runs in a forked child which shares the preloaded sequences
+    // with the server, so that invalid input (which is fatal to a polisher)
+    // ends the job only and leaves the server's state untouched
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0) {
+        sendAll(connection, "error: unable to start job!\n");
+        return true;
+    }
+
+    if (pid == 0) {
+        close(socket_);
+        polisher_->restart_threads();
+
+        if (!polisher_->reset(overlaps_path, target_path)) {
+            sendAll(connection, "error: unable to open overlaps or target "
+                "sequences (or unsupported format extension)!\n");
+            _exit(kReportedError);
+        }
+
+        fprintf(stderr, "[racon::Server::process] polishing %s with %s\n",
+            target_path.c_str(), overlaps_path.c_str());
+
+        bool is_connected = true;
+        polisher_->run([&](std::unique_ptr<Sequence> sequence) -> void {
+            if (is_connected) {
+                is_connected = sendAll(connection, ">" + sequence->name() + "\n" +
+                    sequence->data() + "\n");
+            }
+        }, drop_unpolished_sequences_);
+
+        if (!is_connected) {
+            fprintf(stderr, "[racon::Server::process] warning: "
+                "client disconnected before receiving all sequences!\n");
+        }
+
+        fflush(stderr);
+        _exit(0);
+    }
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+    if (!WIFEXITED(status) || (WEXITSTATUS(status) != 0 &&
+        WEXITSTATUS(status) != kReportedError)) {
+
+        fprintf(stderr, "[racon::Server::process] warning: "
+            "job polishing %s with %s failed!\n", target_path.c_str(),
+            overlaps_path.c_str());
+        sendAll(connection, "error: job failed (see the server log)!\n");
+    }
+
+    return true;
+}
+
+}
@@ -0,0 +1,47 @@
+/*!
+ * @file server.hpp
+ *
+ * @brief Server class header file
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <string>
+
+namespace racon {
+
+class Polisher;
+
+class Server;
+std::unique_ptr<Server> createServer(const std::string& socket_path,
+    std::unique_ptr<Polisher> polisher, bool drop_unpolished_sequences);
+
+class Server {
+public:
+    ~Server();
+
+    /*!
+     * @brief Accepts polishing jobs over the Unix socket and processes them
+     * one by one until a shutdown request is received
+     */
+    void run();
+
+    friend std::unique_ptr<Server> createServer(const std::string& socket_path,
+        std::unique_ptr<Polisher> polisher, bool drop_unpolished_sequences);
+private:
+    Server(int32_t socket, const std::string& socket_path,
+        std::unique_ptr<Polisher> polisher, bool drop_unpolished_sequences);
+    Server(const Server&) = delete;
+    const Server& operator=(const Server&) = delete;
+
+    bool process(int32_t connection);
+
+    int32_t socket_;
+    std::string socket_path_;
+    std::unique_ptr<Polisher> polisher_;
+    bool drop_unpolished_sequences_;
+};
+
+}
@@ -0,0 +1,306 @@
+/*!
+ * @file source.cpp
+ *
+ * @brief Source class source file
+ */
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <iterator>
+#include <mutex>
+#include <thread>
+
+#include "sequence.hpp"
+#include "overlap.hpp"
+#include "source.hpp"
+
+#include "bioparser/bioparser.hpp"
+
+namespace racon {
+
+template<class T>
+class ParserSource: public Source<T> {
+public:
+    ParserSource(std::unique_ptr<bioparser::Parser<T>> parser, uint64_t size)
+            : parser_(std::move(parser)), size_(size) {
+    }
+
+    ~ParserSource() {}
+
+    void reset() override {
+        parser_->reset();
+    }
+
+    bool parse(std::vector<std::unique_ptr<T>>& dst, uint64_t max_bytes) override {
+        return parser_->parse(dst, max_bytes);
+    }
+
+    uint64_t size() const override {
+        return size_;
+    }
+
+private:
+    std::unique_ptr<bioparser::Parser<T>> parser_;
+    uint64_t size_;
+};
+
+class SequenceSpanSource: public Source<Sequence> {
+public:
+    SequenceSpanSource(const SequenceSpan* spans, uint64_t num_spans)
+            : spans_(spans), num_spans_(num_spans), next_span_(0), size_(0) {
+
+        for (uint64_t i = 0; i < num_spans_; ++i) {
+            size_ += spans_[i].name_length + spans_[i].data_length +
+                spans_[i].quality_length;
+        }
+    }
+
+    ~SequenceSpanSource() {}
+
+    void reset() override {
+        next_span_ = 0;
+    }
+
+    bool parse(std::vector<std::unique_ptr<Sequence>>& dst,
+        uint64_t max_bytes) override {
+
+        uint64_t bytes = 0;
+        for (; next_span_ < num_spans_ && bytes < max_bytes; ++next_span_) {
+            const auto& it = spans_[next_span_];
+            if (it.quality == nullptr || it.quality_length == 0) {
+                dst.emplace_back(new Sequence(it.name, it.name_length, it.data,
+                    it.data_length));
+            } else {
+                dst.emplace_back(new Sequence(it.name, it.name_length, it.data,
+                    it.data_length, it.quality, it.quality_length));
+            }
+            bytes += it.name_length + it.data_length + it.quality_length;
+        }
+        return next_span_ < num_spans_;
+    }
+
+    uint64_t size() const override {
+        return size_;
+    }
+
+private:
+    const SequenceSpan* spans_;
+    uint64_t num_spans_;
+    uint64_t next_span_;
+    uint64_t size_;
+};
+
+class OverlapSpanSource: public Source<Overlap> {
+public:
+    OverlapSpanSource(const OverlapSpan* spans, uint64_t num_spans)
+            : spans_(spans), num_spans_(num_spans), next_span_(0), size_(0) {
+
+        for (uint64_t i = 0; i < num_spans_; ++i) {
+            size_ += sizeof(OverlapSpan) + spans_[i].q_name_length +
+                spans_[i].t_name_length;
+        }
+    }
+
+    ~OverlapSpanSource() {}
+
+    void reset() override {
+        next_span_ = 0;
+    }
+
+    bool parse(std::vector<std::unique_ptr<Overlap>>& dst,
+        uint64_t max_bytes) override {
+
+        uint64_t bytes = 0;
+        for (; next_span_ < num_spans_ && bytes < max_bytes; ++next_span_) {
+            const auto& it = spans_[next_span_];
+            dst.emplace_back(new Overlap(it.q_name, it.q_name_length,
+                it.q_length, it.q_begin, it.q_end, it.orientation, it.t_name,
+                it.t_name_length, it.t_length, it.t_begin, it.t_end,
+                it.matching_bases, it.overlap_length, it.mapping_quality));
+            bytes += sizeof(OverlapSpan) + it.q_name_length + it.t_name_length;
+        }
+        return next_span_ < num_spans_;
+    }
+
+    uint64_t size() const override {
+        return size_;
+    }
+
+private:
+    const OverlapSpan* spans_;
+    uint64_t num_spans_;
+    uint64_t next_span_;
+    uint64_t size_;
+};
+
+constexpr uint64_t kPrefetchChunkSize = 1024 * 1024; // ~ 1MB
+
+template<class T>
+class PrefetchSource: public Source<T> {
+public:
+    PrefetchSource(std::unique_ptr<Source<T>> source, uint64_t max_bytes)
+            : source_(std::move(source)), max_chunks_(std::max<uint64_t>(1,
+            max_bytes / kPrefetchChunkSize)), mutex_(), condition_(), chunks_(),
+            generation_(0), is_stopped_(false), is_pass_start_(true),
+            is_exhausted_(false), thread_() {
+
+        thread_ = std::thread(&PrefetchSource::prefetch, this);
+    }
+
+    ~PrefetchSource() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            is_stopped_ = true;
+        }
+        condition_.notify_all();
+        thread_.join();
+    }
+
+    // chunks of the next pass are kept unless the current one is unfinished
+    void reset() override {
+        std::lock_guard<std::mutex> lock(mutex_);
+        is_exhausted_ = false;
+        if (is_pass_start_) {
+            return;
+        }
+        ++generation_;
+        chunks_.clear();
+        is_pass_start_ = true;
+        condition_.notify_all();
+    }
+
+    uint64_t size() const override {
+        return source_->size();
+    }
+
+    // prefetched chunks are counted as kPrefetchChunkSize bytes each
+    bool parse(std::vector<std::unique_ptr<T>>& dst, uint64_t max_bytes) override {
+        uint64_t bytes = 0;
+        do {
+            Chunk chunk;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                if (is_exhausted_) {
+                    return false;
+                }
+                condition_.wait(lock, [&] () -> bool {
+                    return !chunks_.empty();
+                });
+                chunk = std::move(chunks_.front());
+                chunks_.pop_front();
+                is_pass_start_ = chunk.is_last;
+                is_exhausted_ = chunk.is_last;
+            }
+            condition_.notify_all();
+
+            dst.insert(dst.end(), std::make_move_iterator(chunk.objects.begin()),
+                std::make_move_iterator(chunk.objects.end()));
+            if (chunk.is_last) {
+                return false;
+            }
+            bytes += kPrefetchChunkSize;
+        } while (bytes < max_bytes);
+
+        return true;
+    }
+
+private:
+    struct Chunk {
+        std::vector<std::unique_ptr<T>> objects;
+        bool is_last;
+    };
+
+    void prefetch() {
+        uint64_t generation = 0;
+        bool is_reset = false;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (true) {
+            condition_.wait(lock, [&] () -> bool {
+                return is_stopped_ || generation != generation_ ||
+                    chunks_.size() < max_chunks_;
+            });
+            if (is_stopped_) {
+                return;
+            }
+            if (generation != generation_) {
+                generation = generation_;
+                is_reset = true;
+            }
+            lock.unlock();
+
+            // only this thread touches the underlying source
+            if (is_reset) {
+                source_->reset();
+                is_reset = false;
+            }
+            Chunk chunk;
+            chunk.is_last = !source_->parse(chunk.objects, kPrefetchChunkSize);
+            if (chunk.is_last) {
+                source_->reset();
+            }
+
+            lock.lock();
+            // chunks parsed before a reset of an unfinished pass are dropped
+            if (generation == generation_) {
+                chunks_.emplace_back(std::move(chunk));
+                condition_.notify_all();
+            }
+        }
+    }
+
+    std::unique_ptr<Source<T>> source_;
+    uint64_t max_chunks_;
+    std::mutex mutex_;
+    std::condition_variable condition_;
+    std::deque<Chunk> chunks_;
+    uint64_t generation_;
+    bool is_stopped_;
+    bool is_pass_start_;
+    bool is_exhausted_;
+    std::thread thread_;
+};
+
+std::unique_ptr<Source<Sequence>> createSource(
+    std::unique_ptr<bioparser::Parser<Sequence>> parser, uint64_t size) {
+
+    return std::unique_ptr<Source<Sequence>>(new ParserSource<Sequence>(
+        std::move(parser), size));
+}
+
+std::unique_ptr<Source<Overlap>> createSource(
+    std::unique_ptr<bioparser::Parser<Overlap>> parser, uint64_t size) {
+
+    return std::unique_ptr<Source<Overlap>>(new ParserSource<Overlap>(
+        std::move(parser), size));
+}
+
+std::unique_ptr<Source<Sequence>> createSource(const SequenceSpan* spans,
+    uint64_t num_spans) {
+
+    return std::unique_ptr<Source<Sequence>>(new SequenceSpanSource(spans,
+        num_spans));
+}
+
+std::unique_ptr<Source<Overlap>> createSource(const OverlapSpan* spans,
+    uint64_t num_spans) {
+
+    return std::unique_ptr<Source<Overlap>>(new OverlapSpanSource(spans,
+        num_spans));
+}
+
+std::unique_ptr<Source<Sequence>> createPrefetchSource(
+    std::unique_ptr<Source<Sequence>> source, uint64_t max_bytes) {
+
+    return std::unique_ptr<Source<Sequence>>(new PrefetchSource<Sequence>(
+        std::move(source), max_bytes));
+}
+
+std::unique_ptr<Source<Overlap>> createPrefetchSource(
+    std::unique_ptr<Source<Overlap>> source, uint64_t max_bytes) {
+
+    return std::unique_ptr<Source<Overlap>>(new PrefetchSource<Overlap>(
+        std::move(source), max_bytes));
+}
+
+}
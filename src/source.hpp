@@ -0,0 +1,113 @@
+/*!
+ * @file source.hpp
+ *
+ * @brief Source class header file
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <memory>
+#include <vector>
+
+namespace bioparser {
+    template<class T>
+    class Parser;
+}
+
+namespace racon {
+
+class Sequence;
+class Overlap;
+
+/*!
+ * @brief View of a sequence stored in memory owned by the caller (quality
+ * is optional)
+ */
+struct SequenceSpan {
+    const char* name;
+    uint32_t name_length;
+    const char* data;
+    uint32_t data_length;
+    const char* quality;
+    uint32_t quality_length;
+};
+
+/*!
+ * @brief View of an overlap stored in memory owned by the caller (fields
+ * equal those of the PAF format)
+ */
+struct OverlapSpan {
+    const char* q_name;
+    uint32_t q_name_length;
+    uint32_t q_length;
+    uint32_t q_begin;
+    uint32_t q_end;
+    char orientation;
+    const char* t_name;
+    uint32_t t_name_length;
+    uint32_t t_length;
+    uint32_t t_begin;
+    uint32_t t_end;
+    uint32_t matching_bases;
+    uint32_t overlap_length;
+    uint32_t mapping_quality;
+};
+
+/*!
+ * @brief Provides sequences or overlaps to the polisher in chunks, either
+ * parsed from a file or created from spans
+ */
+template<class T>
+class Source {
+public:
+    virtual ~Source() {}
+
+    virtual void reset() = 0;
+
+    /*!
+     * @brief Appends objects worth approximately max_bytes to dst and returns
+     * false if there are none left
+     */
+    virtual bool parse(std::vector<std::unique_ptr<T>>& dst, uint64_t max_bytes) = 0;
+
+    /*!
+     * @brief Approximate number of bytes parsed in a pass (in the units of
+     * max_bytes), 0 if unknown
+     */
+    virtual uint64_t size() const {
+        return 0;
+    }
+};
+
+/*!
+ * @brief Size is the number of uncompressed input bytes if known
+ */
+std::unique_ptr<Source<Sequence>> createSource(
+    std::unique_ptr<bioparser::Parser<Sequence>> parser, uint64_t size = 0);
+
+std::unique_ptr<Source<Overlap>> createSource(
+    std::unique_ptr<bioparser::Parser<Overlap>> parser, uint64_t size = 0);
+
+/*!
+ * @brief Spans have to outlive the source, objects are created from them
+ * chunk by chunk (i.e. the caller's buffers are copied on each pass)
+ */
+std::unique_ptr<Source<Sequence>> createSource(const SequenceSpan* spans,
+    uint64_t num_spans);
+
+std::unique_ptr<Source<Overlap>> createSource(const OverlapSpan* spans,
+    uint64_t num_spans);
+
+/*!
+ * @brief Parses chunks of the given source on a dedicated thread ahead of the
+ * caller, keeping at most max_bytes of them; once a pass ends the next one is
+ * prefetched, so that reset() at the end of a pass discards nothing
+ */
+std::unique_ptr<Source<Sequence>> createPrefetchSource(
+    std::unique_ptr<Source<Sequence>> source, uint64_t max_bytes);
+
+std::unique_ptr<Source<Overlap>> createPrefetchSource(
+    std::unique_ptr<Source<Overlap>> source, uint64_t max_bytes);
+
+}
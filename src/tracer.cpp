@@ -0,0 +1,142 @@
+/*!
+ * @file tracer.cpp
+ *
+ * @brief Tracer source file
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <iterator>
+#include <new>
+
+#include "tracer.hpp"
+
+namespace racon {
+
+constexpr uint32_t kReservedEvents = 1024;
+constexpr size_t kCacheLineSize = 64;
+
+void Tracer::BufferDeleter::operator()(Buffer* buffer) const {
+    buffer->~Buffer();
+    free(buffer);
+}
+
+std::unique_ptr<Tracer::Buffer, Tracer::BufferDeleter> Tracer::createBuffer() {
+
+    static_assert(sizeof(Buffer) == kCacheLineSize,
+        "Tracer::Buffer has to fill a cache line");
+
+    // the allocator of std::vector ignores over-alignment in C++11
+    void* memory = nullptr;
+    if (posix_memalign(&memory, kCacheLineSize, sizeof(Buffer)) != 0) {
+        fprintf(stderr, "[racon::Tracer::createBuffer] error: "
+            "unable to allocate memory!\n");
+        exit(1);
+    }
+    return std::unique_ptr<Buffer, BufferDeleter>(new(memory) Buffer());
+}
+
+Tracer::Tracer(const std::vector<std::thread::id>& thread_identifiers)
+        : is_enabled_(false), time_point_(std::chrono::steady_clock::now()),
+        thread_to_id_(), main_thread_id_(std::this_thread::get_id()),
+        buffers_(), mutex_(), phases_() {
+
+    for (uint32_t i = 0; i < thread_identifiers.size() + 2; ++i) {
+        buffers_.emplace_back(createBuffer());
+    }
+
+    uint32_t id = 0;
+    for (const auto& it: thread_identifiers) {
+        thread_to_id_[it] = id++;
+    }
+}
+
+Tracer::~Tracer() {
+}
+
+void Tracer::enable() {
+    if (is_enabled_) {
+        return;
+    }
+    for (auto& it: buffers_) {
+        it->events.reserve(kReservedEvents);
+    }
+    is_enabled_ = true;
+}
+
+uint64_t Tracer::now() const {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - time_point_).count();
+}
+
+void Tracer::record(const char* name, uint64_t begin) {
+    if (!is_enabled_) {
+        return;
+    }
+    uint64_t end = now();
+    auto thread_id = std::this_thread::get_id();
+    auto it = thread_to_id_.find(thread_id);
+    if (it != thread_to_id_.end()) {
+        buffers_[it->second]->events.push_back({name, begin, end});
+    } else if (thread_id == main_thread_id_) {
+        buffers_[buffers_.size() - 2]->events.push_back({name, begin, end});
+    } else {
+        std::lock_guard<std::mutex> lock(mutex_);
+        buffers_.back()->events.push_back({name, begin, end});
+    }
+}
+
+void Tracer::start(const char* phase) {
+    if (!is_enabled_) {
+        return;
+    }
+    phases_.emplace_back(phase, now());
+}
+
+void Tracer::stop(const char* phase) {
+    if (!is_enabled_) {
+        return;
+    }
+    for (auto it = phases_.rbegin(); it != phases_.rend(); ++it) {
+        if (strcmp(it->first, phase) == 0) {
+            buffers_[buffers_.size() - 2]->events.push_back({phase, it->second, now()});
+            phases_.erase(std::next(it).base());
+            return;
+        }
+    }
+}
+
+bool Tracer::write(const std::string& path) const {
+
+    FILE* file = fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        return false;
+    }
+
+    fprintf(file, "{\"traceEvents\": [");
+    for (uint32_t i = 0; i < buffers_.size(); ++i) {
+        if (i + 2 >= buffers_.size()) {
+            fprintf(file, "%s\n  {\"name\": \"thread_name\", \"ph\": \"M\", "
+                "\"pid\": 0, \"tid\": %u, \"args\": {\"name\": \"%s\"}}",
+                i == 0 ? "" : ",", i, i + 1 == buffers_.size() ? "other" : "main");
+        } else {
+            fprintf(file, "%s\n  {\"name\": \"thread_name\", \"ph\": \"M\", "
+                "\"pid\": 0, \"tid\": %u, \"args\": {\"name\": \"worker %u\"}}",
+                i == 0 ? "" : ",", i, i);
+        }
+    }
+    for (uint32_t i = 0; i < buffers_.size(); ++i) {
+        for (const auto& it: buffers_[i]->events) {
+            fprintf(file, ",\n  {\"name\": \"%s\", \"ph\": \"X\", \"pid\": 0, "
+                "\"tid\": %u, \"ts\": %.3f, \"dur\": %.3f}", it.name, i,
+                it.begin / 1e3, (it.end - it.begin) / 1e3);
+        }
+    }
+    fprintf(file, "\n], \"displayTimeUnit\": \"ms\"}\n");
+
+    fclose(file);
+    return true;
+}
+
+}
@@ -0,0 +1,97 @@
+/*!
+ * @file tracer.hpp
+ *
+ * @brief Tracer header file
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace racon {
+
+/*!
+ * @brief Records timelines of thread pool tasks and main thread phases in the
+ * Chrome trace event format; listed threads and the main thread append only
+ * to their own buffers so no locking is needed, other threads (e.g. I/O
+ * helpers) share a locked buffer
+ */
+class Tracer {
+public:
+    /*!
+     * @brief The calling thread is the main thread
+     */
+    Tracer(const std::vector<std::thread::id>& thread_identifiers);
+
+    Tracer(const Tracer&) = delete;
+    Tracer& operator=(const Tracer&) = delete;
+
+    ~Tracer();
+
+    void enable();
+
+    bool is_enabled() const {
+        return is_enabled_;
+    }
+
+    /*!
+     * @brief Returns nanoseconds elapsed since the tracer was created
+     */
+    uint64_t now() const;
+
+    /*!
+     * @brief Records an event of the calling thread lasting from begin until
+     * now (does nothing if the tracer is not enabled)
+     */
+    void record(const char* name, uint64_t begin);
+
+    /*!
+     * @brief Record main thread phases (names have to outlive the tracer)
+     */
+    void start(const char* phase);
+    void stop(const char* phase);
+
+    /*!
+     * @brief Writes all events as JSON, returns false if the file can not be
+     * opened
+     */
+    bool write(const std::string& path) const;
+
+private:
+    struct Event {
+        const char* name;
+        uint64_t begin;
+        uint64_t end;
+    };
+
+    // fills a cache line and is allocated at the start of one (see
+    // createBuffer) so that threads do not share one
+    struct Buffer {
+        std::vector<Event> events;
+        char padding[64 - sizeof(std::vector<Event>)];
+    };
+
+    struct BufferDeleter {
+        void operator()(Buffer* buffer) const;
+    };
+
+    static std::unique_ptr<Buffer, BufferDeleter> createBuffer();
+
+    bool is_enabled_;
+    std::chrono::time_point<std::chrono::steady_clock> time_point_;
+    std::unordered_map<std::thread::id, uint32_t> thread_to_id_;
+    std::thread::id main_thread_id_;
+    std::vector<std::unique_ptr<Buffer, BufferDeleter>> buffers_;
+    std::mutex mutex_;
+    std::vector<std::pair<const char*, uint64_t>> phases_;
+};
+
+}
@@ -6,7 +6,9 @@
 
 #include <algorithm>
 
+#include "alphabet.hpp"
 #include "window.hpp"
+#include "banded_alignment_engine.hpp"
 
 #include "spoa/spoa.hpp"
 
@@ -63,82 +65,211 @@ void Window::add_layer(const char* sequence, uint32_t sequence_length,
 }
 
 bool Window::generate_consensus(std::shared_ptr<spoa::AlignmentEngine> alignment_engine,
-    bool trim) {
+    bool trim, std::shared_ptr<BandedAlignmentEngine> banded_alignment_engine) {
 
     if (sequences_.size() < 3) {
         consensus_ = std::string(sequences_.front().first, sequences_.front().second);
         return false;
     }
 
-    auto graph = spoa::createGraph();
-    graph->add_alignment(spoa::Alignment(), sequences_.front().first,
-        sequences_.front().second, qualities_.front().first,
-        qualities_.front().second);
+    auto graph = create_graph();
 
-    std::vector<uint32_t> rank;
-    rank.reserve(sequences_.size());
-    for (uint32_t i = 0; i < sequences_.size(); ++i) {
-        rank.emplace_back(i);
-    }
+    for (const auto& i: sorted_layers()) {
+        auto align = [&](const std::unique_ptr<spoa::Graph>& dst,
+            const std::vector<int32_t>& mapping) -> spoa::Alignment {
 
-    std::sort(rank.begin() + 1, rank.end(), [&](uint32_t lhs, uint32_t rhs) {
-        return positions_[lhs].first < positions_[rhs].first; });
-
-    uint32_t offset = 0.01 * sequences_.front().second;
-    for (uint32_t j = 1; j < sequences_.size(); ++j) {
-        uint32_t i = rank[j];
+            spoa::Alignment alignment;
+            if (banded_alignment_engine == nullptr ||
+                !banded_alignment_engine->align(sequences_[i].first,
+                    sequences_[i].second, dst, positions_[i].first,
+                    positions_[i].second, mapping, alignment)) {
+                alignment = alignment_engine->align(sequences_[i].first,
+                    sequences_[i].second, dst);
+            }
+            return alignment;
+        };
 
         spoa::Alignment alignment;
-        if (positions_[i].first < offset && positions_[i].second >
-            sequences_.front().second - offset) {
-            alignment = alignment_engine->align(sequences_[i].first,
-                sequences_[i].second, graph);
+        if (is_spanning(i)) {
+            alignment = align(graph, std::vector<int32_t>());
         } else {
             std::vector<int32_t> mapping;
             auto subgraph = graph->subgraph(positions_[i].first,
                 positions_[i].second, mapping);
-            alignment = alignment_engine->align( sequences_[i].first,
-                sequences_[i].second, subgraph);
+            alignment = align(subgraph, mapping);
             subgraph->update_alignment(alignment, mapping);
         }
 
-        if (qualities_[i].first == nullptr) {
-            graph->add_alignment(alignment, sequences_[i].first,
-                sequences_[i].second);
-        } else {
-            graph->add_alignment(alignment, sequences_[i].first,
-                sequences_[i].second, qualities_[i].first,
-                qualities_[i].second);
+        add_alignment(graph, alignment, i);
+    }
+
+    create_consensus(graph, trim);
+
+    return true;
+}
+
+uint64_t Window::num_bases() const {
+    uint64_t dst = 0;
+    for (const auto& it: sequences_) {
+        dst += it.second;
+    }
+    return dst;
+}
+
+bool Window::generate_pileup_consensus(bool trim) {
+
+    if (sequences_.size() < 3) {
+        return false;
+    }
+
+    const char* backbone = sequences_.front().first;
+    uint32_t backbone_length = sequences_.front().second;
+
+    auto weight = [&](uint32_t i, uint32_t j) -> uint32_t {
+        return qualities_[i].first == nullptr ? 1 :
+            static_cast<uint32_t>(qualities_[i].first[j]) - 33;
+    };
+
+    // layers as long as their span on the backbone with few mismatches are
+    // treated as free of indels, coverages include the backbone
+    std::vector<uint32_t> coverages(backbone_length, 1);
+    std::vector<uint32_t> gapless_coverages(backbone_length, 1);
+    std::vector<uint64_t> weights(backbone_length * kNumBases, 0);
+    for (uint32_t j = 0; j < backbone_length; ++j) {
+        uint8_t c = encodeBase(backbone[j]);
+        if (c != kUnknownCode) {
+            weights[j * kNumBases + c] += weight(0, j);
         }
     }
 
-    std::vector<uint32_t> coverages;
-    consensus_ = graph->generate_consensus(coverages);
+    for (uint32_t i = 1; i < sequences_.size(); ++i) {
+        uint32_t begin = positions_[i].first;
+        uint32_t length = positions_[i].second - begin + 1;
+        for (uint32_t j = begin; j < begin + length; ++j) {
+            ++coverages[j];
+        }
 
-    if (type_ == WindowType::kTGS && trim) {
-        uint32_t average_coverage = (sequences_.size() - 1) / 2;
+        if (sequences_[i].second != length) {
+            continue;
+        }
+        uint32_t num_mismatches = 0;
+        for (uint32_t j = 0; j < length; ++j) {
+            num_mismatches += sequences_[i].first[j] != backbone[begin + j];
+        }
+        if (num_mismatches > 2 + length / 20) {
+            continue;
+        }
 
-        int32_t begin = 0, end = consensus_.size() - 1;
-        for (; begin < static_cast<int32_t>(consensus_.size()); ++begin) {
-            if (coverages[begin] >= average_coverage) {
-                break;
+        for (uint32_t j = 0; j < length; ++j) {
+            ++gapless_coverages[begin + j];
+            uint8_t c = encodeBase(sequences_[i].first[j]);
+            if (c != kUnknownCode) {
+                weights[(begin + j) * kNumBases + c] += weight(i, j);
             }
         }
-        for (; end >= 0; --end) {
-            if (coverages[end] >= average_coverage) {
-                break;
-            }
+    }
+
+    for (uint32_t j = 0; j < backbone_length; ++j) {
+        if (2 * (gapless_coverages[j] - 1) < coverages[j] - 1) {
+            return false;
         }
+    }
 
-        if (begin >= end) {
-            fprintf(stderr, "[racon::Window::generate_consensus] warning: "
-                "contig %lu might be chimeric in window %u!\n", id_, rank_);
-        } else {
-            consensus_ = consensus_.substr(begin, end - begin + 1);
+    // ties keep the backbone base
+    consensus_.assign(backbone, backbone_length);
+    for (uint32_t j = 0; j < backbone_length; ++j) {
+        uint8_t c = encodeBase(backbone[j]);
+        uint64_t max_weight = c == kUnknownCode ? 0 : weights[j * kNumBases + c];
+        for (uint8_t k = 0; k < kNumBases; ++k) {
+            if (weights[j * kNumBases + k] > max_weight) {
+                max_weight = weights[j * kNumBases + k];
+                consensus_[j] = decodeBase(k);
+            }
         }
     }
 
+    if (type_ == WindowType::kTGS && trim) {
+        trim_consensus(coverages);
+    }
+
     return true;
 }
 
+std::unique_ptr<spoa::Graph> Window::create_graph() const {
+
+    auto graph = spoa::createGraph();
+    graph->add_alignment(spoa::Alignment(), sequences_.front().first,
+        sequences_.front().second, qualities_.front().first,
+        qualities_.front().second);
+    return graph;
+}
+
+std::vector<uint32_t> Window::sorted_layers() const {
+
+    std::vector<uint32_t> dst;
+    dst.reserve(sequences_.size() - 1);
+    for (uint32_t i = 1; i < sequences_.size(); ++i) {
+        dst.emplace_back(i);
+    }
+
+    std::sort(dst.begin(), dst.end(), [&](uint32_t lhs, uint32_t rhs) {
+        return positions_[lhs].first < positions_[rhs].first; });
+
+    return dst;
+}
+
+bool Window::is_spanning(uint32_t i) const {
+    uint32_t offset = 0.01 * sequences_.front().second;
+    return positions_[i].first < offset && positions_[i].second >
+        sequences_.front().second - offset;
+}
+
+void Window::add_alignment(const std::unique_ptr<spoa::Graph>& graph,
+    const std::vector<std::pair<int32_t, int32_t>>& alignment, uint32_t i) const {
+
+    if (qualities_[i].first == nullptr) {
+        graph->add_alignment(alignment, sequences_[i].first,
+            sequences_[i].second);
+    } else {
+        graph->add_alignment(alignment, sequences_[i].first,
+            sequences_[i].second, qualities_[i].first,
+            qualities_[i].second);
+    }
+}
+
+void Window::create_consensus(const std::unique_ptr<spoa::Graph>& graph,
+    bool trim) {
+
+    std::vector<uint32_t> coverages;
+    consensus_ = graph->generate_consensus(coverages);
+
+    if (type_ == WindowType::kTGS && trim) {
+        trim_consensus(coverages);
+    }
+}
+
+void Window::trim_consensus(const std::vector<uint32_t>& coverages) {
+
+    uint32_t average_coverage = (sequences_.size() - 1) / 2;
+
+    int32_t begin = 0, end = consensus_.size() - 1;
+    for (; begin < static_cast<int32_t>(consensus_.size()); ++begin) {
+        if (coverages[begin] >= average_coverage) {
+            break;
+        }
+    }
+    for (; end >= 0; --end) {
+        if (coverages[end] >= average_coverage) {
+            break;
+        }
+    }
+
+    if (begin >= end) {
+        fprintf(stderr, "[racon::Window::generate_consensus] warning: "
+            "contig %lu might be chimeric in window %u!\n", id_, rank_);
+    } else {
+        consensus_ = consensus_.substr(begin, end - begin + 1);
+    }
+}
+
 }
@@ -14,10 +14,13 @@
 
 namespace spoa {
     class AlignmentEngine;
+    class Graph;
 }
 
 namespace racon {
 
+class BandedAlignmentEngine;
+
 enum class WindowType {
     kNGS, // Next Generation Sequencing
     kTGS // Third Generation Sequencing
@@ -39,13 +42,44 @@ public:
     uint32_t rank() const {
         return rank_;
     }
+    WindowType type() const {
+        return type_;
+    }
 
     const std::string& consensus() const {
         return consensus_;
     }
 
+    // excluding the backbone
+    uint32_t num_layers() const {
+        return sequences_.size() - 1;
+    }
+
+    // total length of the backbone and all layers
+    uint64_t num_bases() const;
+
+    // approximate memory footprint (layers are not copied)
+    uint64_t num_bytes() const {
+        return sizeof(Window) + consensus_.capacity() + (sequences_.capacity() +
+            qualities_.capacity()) * sizeof(std::pair<const char*, uint32_t>) +
+            positions_.capacity() * sizeof(std::pair<uint32_t, uint32_t>);
+    }
+
+    /*!
+     * @brief Aligns layers with the banded engine if given, layers it fails
+     * to align are aligned with the (unbanded) alignment engine
+     */
     bool generate_consensus(std::shared_ptr<spoa::AlignmentEngine> alignment_engine,
-        bool trim);
+        bool trim, std::shared_ptr<BandedAlignmentEngine> banded_alignment_engine = nullptr);
+
+    /*!
+     * @brief Generates consensus by a weighted vote (qualities are weights)
+     * over columns of layers which are aligned to the backbone without gaps;
+     * returns false without changing the window if some column is covered
+     * mostly by layers with indels (i.e. generate_consensus is needed for the
+     * whole window, column ranges are not escalated separately)
+     */
+    bool generate_pileup_consensus(bool trim);
 
     void add_layer(const char* sequence, uint32_t sequence_length,
         const char* quality, uint32_t quality_length, uint32_t begin,
@@ -55,6 +89,9 @@ public:
         WindowType type, const char* backbone, uint32_t backbone_length,
         const char* quality, uint32_t quality_length);
 
+    friend class Checkpoint;
+    friend class CPUBatchProcessor;
+
 #ifdef CUDA_ENABLED
     friend class CUDABatchProcessor;
 #endif
@@ -64,6 +101,18 @@ private:
     Window(const Window&) = delete;
     const Window& operator=(const Window&) = delete;
 
+    // steps of generate_consensus shared with batch processors
+    std::unique_ptr<spoa::Graph> create_graph() const;
+    // layers (excluding the backbone) sorted by their begin position
+    std::vector<uint32_t> sorted_layers() const;
+    // spanning layers are aligned to the whole graph instead of a subgraph
+    bool is_spanning(uint32_t i) const;
+    void add_alignment(const std::unique_ptr<spoa::Graph>& graph,
+        const std::vector<std::pair<int32_t, int32_t>>& alignment, uint32_t i) const;
+    void create_consensus(const std::unique_ptr<spoa::Graph>& graph, bool trim);
+    // trims consensus ends covered by less than half of the layers
+    void trim_consensus(const std::vector<uint32_t>& coverages);
+
     uint64_t id_;
     uint32_t rank_;
     WindowType type_;
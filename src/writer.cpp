@@ -0,0 +1,243 @@
+/*!
+ * @file writer.cpp
+ *
+ * @brief Writer class source file
+ */
+
+#include <stdlib.h>
+#include <zlib.h>
+#include <algorithm>
+#include <future>
+
+#include "sequence.hpp"
+#include "writer.hpp"
+
+#include "thread_pool/thread_pool.hpp"
+
+namespace racon {
+
+// BGZF blocks hold at most 64KB, the compressed data of this many bytes
+// always fits into one (as in htslib)
+constexpr uint32_t kBlockSize = 0xff00;
+constexpr uint32_t kMaxBlocks = 64;
+constexpr uint32_t kHeaderSize = 18;
+constexpr uint32_t kFooterSize = 8;
+constexpr uint64_t kBufferSize = 4 * 1024 * 1024;
+
+const std::string kEmptyBlock("\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00"
+    "\x42\x43\x02\x00\x1b\x00\x03\x00\x00\x00\x00\x00\x00\x00\x00\x00", 28);
+
+static void appendLittleEndian(std::string& dst, uint64_t value, uint32_t num_bytes) {
+    for (uint32_t i = 0; i < num_bytes; ++i) {
+        dst += static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+}
+
+static std::string compressBlock(const char* data, uint32_t data_length) {
+
+    z_stream stream;
+    stream.zalloc = Z_NULL;
+    stream.zfree = Z_NULL;
+    stream.opaque = Z_NULL;
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, -15, 8,
+        Z_DEFAULT_STRATEGY) != Z_OK) {
+        fprintf(stderr, "[racon::compressBlock] error: "
+            "unable to initialize zlib!\n");
+        exit(1);
+    }
+
+    std::string dst(kHeaderSize + deflateBound(&stream, data_length) +
+        kFooterSize, '\0');
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+    stream.avail_in = data_length;
+    stream.next_out = reinterpret_cast<Bytef*>(&dst[kHeaderSize]);
+    stream.avail_out = dst.size() - kHeaderSize - kFooterSize;
+    if (deflate(&stream, Z_FINISH) != Z_STREAM_END) {
+        fprintf(stderr, "[racon::compressBlock] error: "
+            "unable to compress data!\n");
+        exit(1);
+    }
+    uint32_t compressed_length = stream.total_out;
+    deflateEnd(&stream);
+
+    // gzip header with the BC extra field holding the block size - 1
+    std::string header("\x1f\x8b\x08\x04\x00\x00\x00\x00\x00\xff\x06\x00"
+        "\x42\x43\x02\x00", 16);
+    appendLittleEndian(header, kHeaderSize + compressed_length + kFooterSize - 1, 2);
+    std::copy(header.begin(), header.end(), dst.begin());
+
+    std::string footer;
+    appendLittleEndian(footer, crc32(crc32(0L, Z_NULL, 0),
+        reinterpret_cast<const Bytef*>(data), data_length), 4);
+    appendLittleEndian(footer, data_length, 4);
+    std::copy(footer.begin(), footer.end(), dst.begin() + kHeaderSize +
+        compressed_length);
+
+    dst.resize(kHeaderSize + compressed_length + kFooterSize);
+    return dst;
+}
+
+static void writeData(FILE* file, const char* data, uint64_t data_length,
+    const std::string& path) {
+
+    if (fwrite(data, 1, data_length, file) != data_length) {
+        fprintf(stderr, "[racon::writeData] error: "
+            "unable to write to file %s!\n", path.c_str());
+        exit(1);
+    }
+}
+
+static void closeFile(FILE* file, const std::string& path) {
+    if (fclose(file) != 0) {
+        fprintf(stderr, "[racon::closeFile] error: "
+            "unable to close file %s!\n", path.c_str());
+        exit(1);
+    }
+}
+
+std::unique_ptr<Writer> createWriter(const std::string& path, bool is_indexed,
+    uint32_t num_threads) {
+
+    FILE* file = fopen(path.c_str(), "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "[racon::createWriter] error: "
+            "unable to open file %s!\n", path.c_str());
+        exit(1);
+    }
+
+    bool is_compressed = path.size() > 3 &&
+        path.compare(path.size() - 3, 3, ".gz") == 0;
+
+    return std::unique_ptr<Writer>(new Writer(path, file, is_compressed,
+        is_indexed, num_threads));
+}
+
+Writer::Writer(const std::string& path, FILE* file, bool is_compressed,
+    bool is_indexed, uint32_t num_threads)
+        : path_(path), file_(file), is_compressed_(is_compressed),
+        is_indexed_(is_indexed), buffer_(), offset_(0), compressed_offset_(0),
+        fai_(), gzi_(), thread_pool_(is_compressed ?
+        thread_pool::createThreadPool(num_threads) : nullptr) {
+}
+
+Writer::~Writer() {
+    close();
+}
+
+void Writer::write(const Sequence& sequence) {
+
+    if (file_ == nullptr) {
+        fprintf(stderr, "[racon::Writer::write] error: "
+            "writer is closed!\n");
+        exit(1);
+    }
+
+    // faidx uses the name up to the first whitespace, sequences are written
+    // on a single line
+    if (is_indexed_) {
+        const auto& name = sequence.name();
+        uint64_t offset = offset_ + buffer_.size() + name.size() + 2;
+        fai_ += name.substr(0, name.find_first_of(" \t")) + "\t" +
+            std::to_string(sequence.data().size()) + "\t" +
+            std::to_string(offset) + "\t" +
+            std::to_string(sequence.data().size()) + "\t" +
+            std::to_string(sequence.data().size() + 1) + "\n";
+    }
+
+    buffer_ += ">";
+    buffer_ += sequence.name();
+    buffer_ += "\n";
+    buffer_ += sequence.data();
+    buffer_ += "\n";
+
+    if (buffer_.size() >= (is_compressed_ ? kMaxBlocks * kBlockSize : kBufferSize)) {
+        flush(false);
+    }
+}
+
+void Writer::flush(bool is_final) {
+
+    if (!is_compressed_) {
+        writeData(file_, buffer_.data(), buffer_.size(), path_);
+        offset_ += buffer_.size();
+        buffer_.clear();
+        return;
+    }
+
+    uint64_t num_blocks = is_final ? (buffer_.size() + kBlockSize - 1) / kBlockSize :
+        buffer_.size() / kBlockSize;
+
+    std::vector<std::future<std::string>> thread_futures;
+    for (uint64_t i = 0; i < num_blocks; ++i) {
+        thread_futures.emplace_back(thread_pool_->submit(
+            [&](uint64_t j) -> std::string {
+                return compressBlock(&buffer_[j * kBlockSize], std::min<uint64_t>(
+                    kBlockSize, buffer_.size() - j * kBlockSize));
+            }, i));
+    }
+
+    uint64_t length = 0;
+    for (auto& it: thread_futures) {
+        std::string block = it.get();
+        writeData(file_, block.data(), block.size(), path_);
+        compressed_offset_ += block.size();
+        length += std::min<uint64_t>(kBlockSize, buffer_.size() - length);
+        gzi_.emplace_back(compressed_offset_, offset_ + length);
+    }
+
+    offset_ += length;
+    buffer_.erase(0, length);
+}
+
+void Writer::close() {
+
+    if (file_ == nullptr) {
+        return;
+    }
+
+    flush(true);
+    if (is_compressed_) {
+        writeData(file_, kEmptyBlock.data(), kEmptyBlock.size(), path_);
+    }
+    closeFile(file_, path_);
+    file_ = nullptr;
+
+    if (!is_indexed_) {
+        return;
+    }
+
+    FILE* fai = fopen((path_ + ".fai").c_str(), "w");
+    if (fai == nullptr) {
+        fprintf(stderr, "[racon::Writer::close] error: "
+            "unable to open file %s.fai!\n", path_.c_str());
+        exit(1);
+    }
+    writeData(fai, fai_.data(), fai_.size(), path_ + ".fai");
+    closeFile(fai, path_ + ".fai");
+
+    if (!is_compressed_) {
+        return;
+    }
+
+    // the start of the end-of-file block is not an entry
+    if (!gzi_.empty()) {
+        gzi_.pop_back();
+    }
+    std::string gzi;
+    appendLittleEndian(gzi, gzi_.size(), 8);
+    for (const auto& it: gzi_) {
+        appendLittleEndian(gzi, it.first, 8);
+        appendLittleEndian(gzi, it.second, 8);
+    }
+
+    FILE* file = fopen((path_ + ".gzi").c_str(), "wb");
+    if (file == nullptr) {
+        fprintf(stderr, "[racon::Writer::close] error: "
+            "unable to open file %s.gzi!\n", path_.c_str());
+        exit(1);
+    }
+    writeData(file, gzi.data(), gzi.size(), path_ + ".gzi");
+    closeFile(file, path_ + ".gzi");
+}
+
+}
@@ -0,0 +1,76 @@
+/*!
+ * @file writer.hpp
+ *
+ * @brief Writer class header file
+ */
+
+#pragma once
+
+#include <stdio.h>
+#include <stdint.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace thread_pool {
+    class ThreadPool;
+}
+
+namespace racon {
+
+class Sequence;
+
+class Writer;
+std::unique_ptr<Writer> createWriter(const std::string& path, bool is_indexed,
+    uint32_t num_threads);
+
+/*!
+ * @brief Writes sequences in FASTA format, paths ending with .gz are
+ * compressed in BGZF blocks (readable by gzip and bgzip) on a thread pool;
+ * the index (.fai and, for compressed output, .gzi as written by samtools
+ * faidx and bgzip -i) is created once the writer is closed; failed writes
+ * are fatal
+ *
+ * Writing is a serial stage after each batch, it does not overlap with
+ * consensus: the polisher passes polished sequences on once a batch is
+ * finished, and the writer's own thread pool compresses them while the
+ * polisher's pool waits for the next batch
+ */
+class Writer {
+public:
+    ~Writer();
+
+    void write(const Sequence& sequence);
+
+    /*!
+     * @brief Flushes the remaining data and writes the index (called by the
+     * destructor if needed)
+     */
+    void close();
+
+    friend std::unique_ptr<Writer> createWriter(const std::string& path,
+        bool is_indexed, uint32_t num_threads);
+private:
+    Writer(const std::string& path, FILE* file, bool is_compressed,
+        bool is_indexed, uint32_t num_threads);
+    Writer(const Writer&) = delete;
+    const Writer& operator=(const Writer&) = delete;
+
+    // writes the buffered data, only whole blocks unless is_final is set
+    void flush(bool is_final);
+
+    std::string path_;
+    FILE* file_;
+    bool is_compressed_;
+    bool is_indexed_;
+    std::string buffer_;
+    // uncompressed and compressed bytes written to the file so far
+    uint64_t offset_;
+    uint64_t compressed_offset_;
+    std::string fai_;
+    // compressed and uncompressed offsets of blocks after the first one
+    std::vector<std::pair<uint64_t, uint64_t>> gzi_;
+    std::unique_ptr<thread_pool::ThreadPool> thread_pool_;
+};
+
+}
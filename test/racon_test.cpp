@@ -4,15 +4,34 @@
  * @brief Racon unit test source file
  */
 
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <zlib.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <functional>
+
 #include "racon_test_config.h"
 
 #include "sequence.hpp"
+#include "overlap.hpp"
+#include "window.hpp"
+#include "backend.hpp"
 #include "polisher.hpp"
+#include "writer.hpp"
+#include "numa.hpp"
 
 #include "edlib.h"
 #include "bioparser/bioparser.hpp"
 #include "gtest/gtest.h"
 
+// edit distance of the default consensus of the sample reads to the reference
+constexpr uint32_t kEditDistance = 1312;
+// bound for backends which approximate the default one (within 5%)
+constexpr uint32_t kApproximateEditDistance = kEditDistance + (kEditDistance + 19) / 20;
+
 uint32_t calculateEditDistance(const std::string& query, const std::string& target) {
 
     EdlibAlignResult result = edlibAlign(query.c_str(), query.size(), target.c_str(),
@@ -24,23 +43,59 @@ uint32_t calculateEditDistance(const std::string& query, const std::string& targ
     return edit_distance;
 }
 
+std::string readFile(const std::string& path) {
+
+    std::string dst;
+    FILE* file = fopen(path.c_str(), "r");
+    if (file == nullptr) {
+        return dst;
+    }
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), file)) > 0) {
+        dst.append(buffer, n);
+    }
+    fclose(file);
+
+    return dst;
+}
+
 class RaconPolishingTest: public ::testing::Test {
 public:
     void SetUp(const std::string& sequences_path, const std::string& overlaps_path,
         const std::string& target_path, racon::PolisherType type,
         uint32_t window_length, double quality_threshold, double error_threshold,
         int8_t match, int8_t mismatch, int8_t gap, uint32_t cuda_batches = 0,
-        bool cuda_banded_alignment = false, uint32_t cudaaligner_batches = 0) {
+        bool cuda_banded_alignment = false, uint32_t cudaaligner_batches = 0,
+        const std::string& regions_path = "",
+        const std::string& checkpoint_directory = "", uint32_t shard_id = 0,
+        uint32_t num_shards = 1, uint64_t batch_size = 0,
+        uint64_t max_memory = 0) {
 
         polisher = racon::createPolisher(sequences_path, overlaps_path, target_path,
             type, window_length, quality_threshold, error_threshold, true, match,
-            mismatch, gap, 4, cuda_batches, cuda_banded_alignment, cudaaligner_batches);
+            mismatch, gap, 4, cuda_batches, cuda_banded_alignment, cudaaligner_batches,
+            0, regions_path, checkpoint_directory, shard_id, num_shards,
+            batch_size, max_memory);
     }
 
     void TearDown() {}
 
-    void initialize() {
-        polisher->initialize();
+    // content which write stores to a temporary file
+    std::string written(const std::function<bool(const std::string&)>& write) {
+        char path[] = "/tmp/racon_test_XXXXXX";
+        int32_t fd = mkstemp(path);
+        EXPECT_NE(fd, -1);
+        close(fd);
+
+        EXPECT_TRUE(write(path));
+        auto dst = readFile(path);
+        EXPECT_EQ(remove(path), 0);
+        return dst;
+    }
+
+    bool initialize() {
+        return polisher->initialize();
     }
 
     void polish(std::vector<std::unique_ptr<racon::Sequence>>& dst,
@@ -85,6 +140,23 @@ TEST(RaconInitializeTest, TargetPathExtensionError) {
         ".fna.gz, .fa, .fa.gz, .fastq, .fastq.gz, .fq, .fq.gz.!");
 }
 
+TEST(RaconInitializeTest, RegionsPathExtensionError) {
+    EXPECT_DEATH((racon::createPolisher(racon_test_data_path + "sample_reads.fastq.gz",
+        racon_test_data_path + "sample_overlaps.paf.gz", racon_test_data_path +
+        "sample_layout.fasta.gz", racon::PolisherType::kC, 500, 0, 0, 0, 0, 0, 0,
+        0, 0, false, 0, 0, "regions.txt")), ".racon::createPolisher. error: file "
+        "regions.txt has unsupported format extension .valid extensions: .bed, "
+        ".bed.gz.!");
+}
+
+TEST(RaconInitializeTest, ShardError) {
+    EXPECT_DEATH((racon::createPolisher(racon_test_data_path + "sample_reads.fastq.gz",
+        racon_test_data_path + "sample_overlaps.paf.gz", racon_test_data_path +
+        "sample_layout.fasta.gz", racon::PolisherType::kC, 500, 0, 0, 0, 0, 0, 0,
+        0, 0, false, 0, 0, "", "", 2, 2)), ".racon::createPolisher. error: "
+        "invalid shard!");
+}
+
 TEST_F(RaconPolishingTest, ConsensusWithQualities) {
     SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
         "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
@@ -104,7 +176,7 @@ TEST_F(RaconPolishingTest, ConsensusWithQualities) {
     EXPECT_EQ(polished_sequences.size(), 2);
 
     EXPECT_EQ(calculateEditDistance(polished_sequences[0]->reverse_complement(),
-        polished_sequences[1]->data()), 1312);
+        polished_sequences[1]->data()), kEditDistance);
 }
 
 TEST_F(RaconPolishingTest, ConsensusWithoutQualities) {
@@ -217,6 +289,425 @@ TEST_F(RaconPolishingTest, ConsensusWithQualitiesEditDistance) {
         polished_sequences[1]->data()), 1321);
 }
 
+TEST_F(RaconPolishingTest, ConsensusWithQualitiesRegions) {
+    SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+        "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
+        racon::PolisherType::kC, 500, 10, 0.3, 5, -4, -8, 0, false, 0,
+        racon_test_data_path + "sample_regions.bed");
+
+    initialize();
+
+    std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+    polish(polished_sequences, true);
+    EXPECT_EQ(polished_sequences.size(), 1);
+
+    // the polished ratio counts only the four selected windows
+    auto tag = polished_sequences[0]->name().find(" XC:f:");
+    ASSERT_NE(tag, std::string::npos);
+    EXPECT_GE(atof(&polished_sequences[0]->name()[tag + 6]), 0.75);
+
+    auto parser = bioparser::createParser<bioparser::FastaParser, racon::Sequence>(
+        racon_test_data_path + "sample_layout.fasta.gz");
+    parser->parse(polished_sequences, -1);
+    EXPECT_EQ(polished_sequences.size(), 2);
+
+    // only windows intersecting [10000, 12000) are polished
+    const auto& polished_data = polished_sequences[0]->data();
+    const auto& layout_data = polished_sequences[1]->data();
+    ASSERT_GE(polished_data.size(), 10000 + 35564);
+    EXPECT_EQ(polished_data.compare(0, 10000, layout_data, 0, 10000), 0);
+    EXPECT_EQ(polished_data.compare(polished_data.size() - 35564, 35564,
+        layout_data, 12000, 35564), 0);
+}
+
+TEST_F(RaconPolishingTest, ConsensusWithQualitiesCheckpoint) {
+    char checkpoint_directory[] = "/tmp/racon_checkpoint_XXXXXX";
+    ASSERT_TRUE(mkdtemp(checkpoint_directory) != nullptr);
+
+    // the second run restores all windows from the checkpoint
+    std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+    for (uint32_t i = 0; i < 2; ++i) {
+        SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+            "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
+            racon::PolisherType::kC, 500, 10, 0.3, 5, -4, -8, 0, false, 0, "",
+            checkpoint_directory);
+
+        initialize();
+        polish(polished_sequences, true);
+        polisher.reset();
+    }
+    EXPECT_EQ(polished_sequences.size(), 2);
+    EXPECT_EQ(polished_sequences[0]->name(), polished_sequences[1]->name());
+    EXPECT_EQ(polished_sequences[0]->data(), polished_sequences[1]->data());
+
+    // options set after creation are part of the signature as well
+    SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+        "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
+        racon::PolisherType::kC, 500, 10, 0.3, 5, -4, -8, 0, false, 0, "",
+        checkpoint_directory);
+    polisher->set_max_coverage(20);
+    EXPECT_DEATH(initialize(), ".racon::Checkpoint::load. error: checkpoint file "
+        ".* was created with different input files or parameters!");
+    polisher.reset();
+
+    EXPECT_EQ(remove((std::string(checkpoint_directory) + "/racon.checkpoint").c_str()), 0);
+    EXPECT_EQ(rmdir(checkpoint_directory), 0);
+}
+
+TEST_F(RaconPolishingTest, ConsensusWithQualitiesMetrics) {
+    SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+        "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
+        racon::PolisherType::kC, 500, 10, 0.3, 5, -4, -8);
+
+    EXPECT_FALSE(polisher->metrics().is_enabled());
+    polisher->enable_metrics();
+    EXPECT_TRUE(polisher->metrics().is_enabled());
+
+    std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+    polisher->run([&](std::unique_ptr<racon::Sequence> sequence) -> void {
+        polished_sequences.emplace_back(std::move(sequence));
+    }, true);
+    EXPECT_EQ(polished_sequences.size(), 1);
+
+    EXPECT_FALSE(polisher->metrics().write("/nonexistent/metrics.json"));
+    auto metrics = written([&](const std::string& path) -> bool {
+        return polisher->metrics().write(path);
+    });
+
+    for (const auto& it: {"\"load_targets\"", "\"load_sequences\"",
+        "\"load_overlaps\"", "\"prepare_sequences\"", "\"align_overlaps\"",
+        "\"build_windows\"", "\"generate_consensus\"", "\"batches\": 1,", "\"layers_per_window\"",
+        "\"windows_polished\""}) {
+        EXPECT_NE(metrics.find(it), std::string::npos) << it;
+    }
+}
+
+TEST_F(RaconPolishingTest, ConsensusWithQualitiesPrefilter) {
+    // overlaps without a segment which reaches the threshold would add no
+    // layers, hence skipping their alignment does not change the consensus
+    std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+    std::vector<uint64_t> num_used_overlaps;
+    for (uint32_t i = 0; i < 2; ++i) {
+        SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+            "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
+            racon::PolisherType::kC, 500, 10, 0.3, 5, -4, -8);
+        if (i == 1) {
+            polisher->enable_quality_prefilter();
+        }
+
+        initialize();
+        polish(polished_sequences, true);
+
+        auto metrics = written([&](const std::string& path) -> bool {
+            return polisher->metrics().write(path);
+        });
+        auto it = metrics.find("\"overlaps_used\": ");
+        ASSERT_NE(it, std::string::npos);
+        num_used_overlaps.emplace_back(strtoull(&metrics[it + 17], nullptr, 10));
+    }
+    ASSERT_EQ(polished_sequences.size(), 2);
+    EXPECT_EQ(polished_sequences[0]->name(), polished_sequences[1]->name());
+    EXPECT_EQ(polished_sequences[0]->data(), polished_sequences[1]->data());
+    EXPECT_LT(num_used_overlaps[1], num_used_overlaps[0]);
+}
+
+TEST(RaconOverlapTest, EstimateQualityReverseStrand) {
+    // qualities of the query rise from 0 over 10 to 20 every 10 bases
+    std::string q_data(30, 'A'), q_quality = std::string(10, '!') +
+        std::string(10, '+') + std::string(10, '5'), t_data(40, 'A');
+    std::vector<racon::SequenceSpan> sequences_spans = {
+        {"q", 1, q_data.c_str(), 30, q_quality.c_str(), 30},
+        {"t", 1, t_data.c_str(), 40, nullptr, 0}};
+    std::vector<std::unique_ptr<racon::Sequence>> sequences;
+    racon::createSource(sequences_spans.data(), sequences_spans.size())->parse(
+        sequences, -1);
+    ASSERT_EQ(sequences.size(), 2);
+    std::unordered_map<std::string, uint64_t> name_to_id = {{"qq", 0}, {"tt", 1}};
+
+    // the target range spans a segment of 10 bases, which is shorter than
+    // the minimal length, and one of 20 bases (t[20, 40) on windows of 20)
+    for (const auto& it: {'+', '-'}) {
+        std::vector<racon::OverlapSpan> overlaps_spans = {
+            {"q", 1, 30, 0, 30, it, "t", 1, 40, 10, 40, 30, 30, 60}};
+        std::vector<std::unique_ptr<racon::Overlap>> overlaps;
+        racon::createSource(overlaps_spans.data(), overlaps_spans.size())->parse(
+            overlaps, -1);
+        ASSERT_EQ(overlaps.size(), 1);
+        overlaps[0]->transmute(sequences, name_to_id, {});
+        ASSERT_TRUE(overlaps[0]->is_valid());
+
+        // on the reverse strand the segment covers the beginning of the query
+        EXPECT_DOUBLE_EQ(overlaps[0]->estimate_quality(sequences, 20, 15),
+            it == '+' ? 15 : 5);
+        EXPECT_DOUBLE_EQ(overlaps[0]->estimate_quality(sequences, 20, 25), -1);
+    }
+}
+
+TEST_F(RaconPolishingTest, ConsensusWithQualitiesMaxCoverage) {
+    SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+        "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
+        racon::PolisherType::kC, 500, 10, 0.3, 5, -4, -8);
+    polisher->set_max_coverage(20);
+
+    initialize();
+
+    std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+    polish(polished_sequences, true);
+    EXPECT_EQ(polished_sequences.size(), 1);
+
+    polished_sequences[0]->create_reverse_complement();
+
+    auto parser = bioparser::createParser<bioparser::FastaParser, racon::Sequence>(
+        racon_test_data_path + "sample_reference.fasta.gz");
+    parser->parse(polished_sequences, -1);
+    EXPECT_EQ(polished_sequences.size(), 2);
+
+    // the best overlaps of windows covered more than 20 times are enough
+    EXPECT_LE(calculateEditDistance(polished_sequences[0]->reverse_complement(),
+        polished_sequences[1]->data()), kApproximateEditDistance);
+
+    auto metrics = written([&](const std::string& path) -> bool {
+        return polisher->metrics().write(path);
+    });
+
+    EXPECT_EQ(metrics.find("\"overlaps_filtered_coverage\": 0"), std::string::npos);
+}
+
+TEST_F(RaconPolishingTest, ConsensusWithQualitiesTrace) {
+    SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+        "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
+        racon::PolisherType::kC, 500, 10, 0.3, 5, -4, -8);
+
+    polisher->enable_tracing();
+
+    std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+    polisher->run([&](std::unique_ptr<racon::Sequence> sequence) -> void {
+        polished_sequences.emplace_back(std::move(sequence));
+    }, true);
+    EXPECT_EQ(polished_sequences.size(), 1);
+
+    auto trace = written([&](const std::string& path) -> bool {
+        return polisher->tracer().write(path);
+    });
+
+    for (const auto& it: {"\"traceEvents\"", "\"worker 3\"", "\"main\"",
+        "\"transmute_sequence\"", "\"align_overlap\"", "\"window_consensus\"",
+        "\"generate_consensus\""}) {
+        EXPECT_NE(trace.find(it), std::string::npos) << it;
+    }
+}
+
+TEST_F(RaconPolishingTest, ConsensusWithQualitiesNuma) {
+    SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+        "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
+        racon::PolisherType::kC, 500, 10, 0.3, 5, -4, -8);
+
+    polisher->enable_numa();
+
+    initialize();
+
+    std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+    polish(polished_sequences, true);
+    EXPECT_EQ(polished_sequences.size(), 1);
+
+    polished_sequences[0]->create_reverse_complement();
+
+    auto parser = bioparser::createParser<bioparser::FastaParser, racon::Sequence>(
+        racon_test_data_path + "sample_reference.fasta.gz");
+    parser->parse(polished_sequences, -1);
+    EXPECT_EQ(polished_sequences.size(), 2);
+
+    EXPECT_EQ(calculateEditDistance(polished_sequences[0]->reverse_complement(),
+        polished_sequences[1]->data()), kEditDistance);
+}
+
+TEST_F(RaconPolishingTest, ConsensusWithQualitiesBanded) {
+    SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+        "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
+        racon::PolisherType::kC, 500, 10, 0.3, 5, -4, -8);
+
+    polisher->enable_banded_alignment(64);
+
+    initialize();
+
+    std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+    polish(polished_sequences, true);
+    EXPECT_EQ(polished_sequences.size(), 1);
+
+    polished_sequences[0]->create_reverse_complement();
+
+    auto parser = bioparser::createParser<bioparser::FastaParser, racon::Sequence>(
+        racon_test_data_path + "sample_reference.fasta.gz");
+    parser->parse(polished_sequences, -1);
+    EXPECT_EQ(polished_sequences.size(), 2);
+
+    EXPECT_LE(calculateEditDistance(polished_sequences[0]->reverse_complement(),
+        polished_sequences[1]->data()), kApproximateEditDistance);
+}
+
+TEST_F(RaconPolishingTest, ConsensusWithQualitiesCpuBatches) {
+    SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+        "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
+        racon::PolisherType::kC, 500, 10, 0.3, 5, -4, -8);
+
+    polisher->enable_cpu_batches();
+
+    initialize();
+
+    std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+    polish(polished_sequences, true);
+    EXPECT_EQ(polished_sequences.size(), 1);
+
+    polished_sequences[0]->create_reverse_complement();
+
+    auto parser = bioparser::createParser<bioparser::FastaParser, racon::Sequence>(
+        racon_test_data_path + "sample_reference.fasta.gz");
+    parser->parse(polished_sequences, -1);
+    EXPECT_EQ(polished_sequences.size(), 2);
+
+    // alignments are optimal and ties are broken as in spoa
+    EXPECT_EQ(calculateEditDistance(polished_sequences[0]->reverse_complement(),
+        polished_sequences[1]->data()), kEditDistance);
+}
+
+TEST_F(RaconPolishingTest, ConsensusWithQualitiesCpuAligner) {
+    SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+        "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
+        racon::PolisherType::kC, 500, 10, 0.3, 5, -4, -8);
+
+    polisher->enable_cpu_aligner();
+
+    initialize();
+
+    std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+    polish(polished_sequences, true);
+    EXPECT_EQ(polished_sequences.size(), 1);
+
+    polished_sequences[0]->create_reverse_complement();
+
+    auto parser = bioparser::createParser<bioparser::FastaParser, racon::Sequence>(
+        racon_test_data_path + "sample_reference.fasta.gz");
+    parser->parse(polished_sequences, -1);
+    EXPECT_EQ(polished_sequences.size(), 2);
+
+    // overlap alignments have the same edit distance as with edlib, but ties
+    // might be broken differently
+    EXPECT_LE(calculateEditDistance(polished_sequences[0]->reverse_complement(),
+        polished_sequences[1]->data()), kApproximateEditDistance);
+
+    auto metrics = written([&](const std::string& path) -> bool {
+        return polisher->metrics().write(path);
+    });
+    EXPECT_NE(metrics.find("\"overlaps_aligned_edlib_fallback\""),
+        std::string::npos);
+}
+
+TEST_F(RaconPolishingTest, ConsensusWithQualitiesBackends) {
+    SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+        "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
+        racon::PolisherType::kC, 500, 10, 0.3, 5, -4, -8);
+
+    EXPECT_TRUE(racon::hasConsensusBackend("spoa"));
+    EXPECT_FALSE(racon::hasAlignerBackend("spoa"));
+
+    // registered backends are created by name
+    racon::registerConsensusBackend("spoa_copy", [](
+        const racon::BackendParameters& parameters) -> std::unique_ptr<racon::ConsensusBackend> {
+        return racon::createConsensusBackend("spoa", parameters);
+    });
+    polisher->set_consensus_backend(racon::WindowType::kNGS, "batch");
+    polisher->set_consensus_backend(racon::WindowType::kTGS, "spoa_copy");
+    polisher->set_aligner_backend("batch");
+
+    std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+    polisher->run([&](std::unique_ptr<racon::Sequence> sequence) -> void {
+        polished_sequences.emplace_back(std::move(sequence));
+    }, true);
+    EXPECT_EQ(polished_sequences.size(), 1);
+
+    auto metrics = written([&](const std::string& path) -> bool {
+        return polisher->metrics().write(path);
+    });
+
+    // windows of long reads are polished by the registered backend
+    for (const auto& it: {"\"consensus_backend_spoa_copy_windows\"",
+        "\"consensus_backend_spoa_copy_bases\"",
+        "\"aligner_backend_batch_overlaps\"",
+        "\"aligner_backend_batch_nanoseconds\""}) {
+        EXPECT_NE(metrics.find(it), std::string::npos) << it;
+    }
+    EXPECT_EQ(metrics.find("\"consensus_backend_batch_windows\""), std::string::npos);
+
+    polished_sequences[0]->create_reverse_complement();
+
+    auto parser = bioparser::createParser<bioparser::FastaParser, racon::Sequence>(
+        racon_test_data_path + "sample_reference.fasta.gz");
+    parser->parse(polished_sequences, -1);
+    EXPECT_EQ(polished_sequences.size(), 2);
+
+    EXPECT_LE(calculateEditDistance(polished_sequences[0]->reverse_complement(),
+        polished_sequences[1]->data()), kApproximateEditDistance);
+}
+
+TEST_F(RaconPolishingTest, ConsensusWithQualitiesPileup) {
+    SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+        "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
+        racon::PolisherType::kC, 500, 10, 0.3, 5, -4, -8);
+
+    polisher->set_consensus_backend(racon::WindowType::kTGS, "pileup");
+
+    initialize();
+
+    std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+    polish(polished_sequences, true);
+    EXPECT_EQ(polished_sequences.size(), 1);
+
+    polished_sequences[0]->create_reverse_complement();
+
+    auto parser = bioparser::createParser<bioparser::FastaParser, racon::Sequence>(
+        racon_test_data_path + "sample_reference.fasta.gz");
+    parser->parse(polished_sequences, -1);
+    EXPECT_EQ(polished_sequences.size(), 2);
+
+    // noisy reads have indels in most windows, which are polished by spoa
+    EXPECT_LE(calculateEditDistance(polished_sequences[0]->reverse_complement(),
+        polished_sequences[1]->data()), kApproximateEditDistance);
+}
+
+TEST(RaconWindowTest, PileupConsensusAccurateReads) {
+    // accurate reads (e.g. short or HiFi ones) differ from the backbone by a
+    // few substitutions only, hence the vote is taken instead of spoa
+    std::string truth = "ACGTTGCAAGCTTACGGATCCATGCAGTCA";
+    std::string backbone = truth, error = truth;
+    backbone[10] = 'A';
+    error[20] = 'G';
+    std::string quality(truth.size(), '5'), low_quality(truth.size(), '!');
+
+    auto window = racon::createWindow(0, 0, racon::WindowType::kNGS,
+        backbone.c_str(), backbone.size(), low_quality.c_str(), low_quality.size());
+    for (uint32_t i = 0; i < 3; ++i) {
+        window->add_layer(truth.c_str(), truth.size(), quality.c_str(),
+            quality.size(), 0, truth.size() - 1);
+    }
+    window->add_layer(error.c_str(), error.size(), quality.c_str(),
+        quality.size(), 0, truth.size() - 1);
+    window->add_layer(truth.c_str() + 5, 10, quality.c_str(), 10, 5, 14);
+
+    EXPECT_TRUE(window->generate_pileup_consensus(false));
+    EXPECT_EQ(window->consensus(), truth);
+
+    // layers with indels are not voted on, the window is left to spoa
+    std::string insertion = truth.substr(0, 15) + "T" + truth.substr(15);
+    auto noisy_window = racon::createWindow(0, 0, racon::WindowType::kNGS,
+        backbone.c_str(), backbone.size(), low_quality.c_str(), low_quality.size());
+    for (uint32_t i = 0; i < 3; ++i) {
+        noisy_window->add_layer(insertion.c_str(), insertion.size(),
+            nullptr, 0, 0, truth.size() - 1);
+    }
+    EXPECT_FALSE(noisy_window->generate_pileup_consensus(false));
+    EXPECT_TRUE(noisy_window->consensus().empty());
+}
+
 TEST_F(RaconPolishingTest, FragmentCorrectionWithQualities) {
     SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
         "sample_ava_overlaps.paf.gz", racon_test_data_path + "sample_reads.fastq.gz",
@@ -289,6 +780,361 @@ TEST_F(RaconPolishingTest, FragmentCorrectionWithQualitiesFullMhap) {
     EXPECT_EQ(total_length, 1658216);
 }
 
+TEST_F(RaconPolishingTest, FragmentCorrectionWithQualitiesFullShards) {
+    uint32_t num_shards = 3, total_size = 0, total_length = 0;
+    for (uint32_t i = 0; i < num_shards; ++i) {
+        SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+            "sample_ava_overlaps.paf.gz", racon_test_data_path + "sample_reads.fastq.gz",
+            racon::PolisherType::kF, 500, 10, 0.3, 1, -1, -1, 0, false, 0, "", "",
+            i, num_shards);
+
+        initialize();
+
+        std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+        polish(polished_sequences, false);
+        EXPECT_LT(polished_sequences.size(), 236);
+
+        for (const auto& it: polished_sequences) {
+            EXPECT_NE(it->name().find(" TI:i:"), std::string::npos);
+            total_length += it->data().size();
+        }
+        total_size += polished_sequences.size();
+
+        polisher.reset();
+    }
+    EXPECT_EQ(total_size, 236);
+    EXPECT_EQ(total_length, 1658216);
+}
+
+TEST_F(RaconPolishingTest, FragmentCorrectionWithQualitiesFullMhapBatches) {
+    SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+        "sample_ava_overlaps.mhap.gz", racon_test_data_path + "sample_reads.fastq.gz",
+        racon::PolisherType::kF, 500, 10, 0.3, 1, -1, -1, 0, false, 0, "", "",
+        0, 1, 200000);
+
+    uint32_t num_batches = 0, total_size = 0, total_length = 0;
+    while (initialize()) {
+        std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+        polish(polished_sequences, false);
+
+        for (const auto& it: polished_sequences) {
+            total_length += it->data().size();
+        }
+        total_size += polished_sequences.size();
+        ++num_batches;
+    }
+    EXPECT_GT(num_batches, 1);
+    EXPECT_EQ(total_size, 236);
+    EXPECT_EQ(total_length, 1658216);
+}
+
+TEST_F(RaconPolishingTest, FragmentCorrectionWithQualitiesFullMhapBatchesPrefetch) {
+    SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+        "sample_ava_overlaps.mhap.gz", racon_test_data_path + "sample_reads.fastq.gz",
+        racon::PolisherType::kF, 500, 10, 0.3, 1, -1, -1, 0, false, 0, "", "",
+        0, 1, 200000);
+    polisher->enable_prefetch(4 * 1024 * 1024);
+
+    // batches might be split differently, each target is polished once
+    uint32_t total_size = 0, total_length = 0;
+    while (initialize()) {
+        std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+        polish(polished_sequences, false);
+
+        for (const auto& it: polished_sequences) {
+            total_length += it->data().size();
+        }
+        total_size += polished_sequences.size();
+    }
+    EXPECT_EQ(total_size, 236);
+    EXPECT_EQ(total_length, 1658216);
+}
+
+TEST_F(RaconPolishingTest, FragmentCorrectionWithQualitiesFullMhapMaxMemory) {
+    SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+        "sample_ava_overlaps.mhap.gz", racon_test_data_path + "sample_reads.fastq.gz",
+        racon::PolisherType::kF, 500, 10, 0.3, 1, -1, -1, 0, false, 0, "", "",
+        0, 1, 0, 4 * 1024 * 1024);
+
+    uint32_t num_batches = 0, total_size = 0, total_length = 0;
+    while (initialize()) {
+        std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+        polish(polished_sequences, false);
+
+        for (const auto& it: polished_sequences) {
+            total_length += it->data().size();
+        }
+        total_size += polished_sequences.size();
+        ++num_batches;
+    }
+    EXPECT_GT(num_batches, 1);
+    EXPECT_EQ(total_size, 236);
+    EXPECT_EQ(total_length, 1658216);
+}
+
+TEST_F(RaconPolishingTest, ConsensusWithQualitiesPreloadedReset) {
+    SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+        "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
+        racon::PolisherType::kC, 500, 10, 0.3, 5, -4, -8);
+
+    polisher->preload_sequences();
+
+    std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+    for (uint32_t i = 0; i < 2; ++i) {
+        EXPECT_TRUE(initialize());
+        polish(polished_sequences, true);
+        EXPECT_FALSE(initialize());
+
+        EXPECT_TRUE(polisher->reset(racon_test_data_path + "sample_overlaps.sam.gz",
+            racon_test_data_path + "sample_layout.fasta.gz"));
+    }
+    EXPECT_FALSE(polisher->reset(racon_test_data_path + "sample_overlaps.txt",
+        racon_test_data_path + "sample_layout.fasta.gz"));
+    EXPECT_EQ(polished_sequences.size(), 2);
+
+    auto parser = bioparser::createParser<bioparser::FastaParser, racon::Sequence>(
+        racon_test_data_path + "sample_reference.fasta.gz");
+    parser->parse(polished_sequences, -1);
+    EXPECT_EQ(polished_sequences.size(), 3);
+
+    for (uint32_t i = 0; i < 2; ++i) {
+        polished_sequences[i]->create_reverse_complement();
+    }
+    EXPECT_EQ(calculateEditDistance(polished_sequences[0]->reverse_complement(),
+        polished_sequences[2]->data()), kEditDistance);
+    EXPECT_EQ(calculateEditDistance(polished_sequences[1]->reverse_complement(),
+        polished_sequences[2]->data()), 1317);
+}
+
+TEST_F(RaconPolishingTest, ConsensusWithQualitiesPreloadedForkedJobs) {
+    SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+        "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
+        racon::PolisherType::kC, 500, 10, 0.3, 5, -4, -8);
+
+    polisher->preload_sequences();
+
+    // jobs run in forked children as in the server, the exit status tells
+    // whether one polished sequence was produced
+    auto run_job = [&](const std::string& target_path) -> int {
+        fflush(stdout);
+        fflush(stderr);
+        pid_t pid = fork();
+        if (pid == 0) {
+            polisher->restart_threads();
+            std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+            if (polisher->reset(racon_test_data_path + "sample_overlaps.paf.gz",
+                target_path)) {
+                polisher->run([&](std::unique_ptr<racon::Sequence> sequence) -> void {
+                    polished_sequences.emplace_back(std::move(sequence));
+                }, true);
+            }
+            _exit(polished_sequences.size() == 1 ? 0 : 3);
+        }
+        int status = -1;
+        waitpid(pid, &status, 0);
+        return WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+    };
+
+    // an empty target file is fatal to the job only
+    char empty_path[] = "/tmp/racon_empty_XXXXXX.fasta";
+    int fd = mkstemps(empty_path, 6);
+    ASSERT_NE(fd, -1);
+    close(fd);
+    EXPECT_EQ(run_job(empty_path), 1);
+    EXPECT_EQ(remove(empty_path), 0);
+
+    EXPECT_EQ(run_job(racon_test_data_path + "sample_layout.fasta.gz"), 0);
+    EXPECT_EQ(run_job(racon_test_data_path + "sample_layout.fasta.gz"), 0);
+}
+
+TEST(RaconPolishingSpansTest, ConsensusWithQualities) {
+    std::vector<std::unique_ptr<racon::Sequence>> sequences;
+    auto sparser = bioparser::createParser<bioparser::FastqParser, racon::Sequence>(
+        racon_test_data_path + "sample_reads.fastq.gz");
+    sparser->parse(sequences, -1);
+
+    std::vector<std::unique_ptr<racon::Sequence>> targets;
+    auto tparser = bioparser::createParser<bioparser::FastaParser, racon::Sequence>(
+        racon_test_data_path + "sample_layout.fasta.gz");
+    tparser->parse(targets, -1);
+
+    auto to_spans = [](const std::vector<std::unique_ptr<racon::Sequence>>& src)
+        -> std::vector<racon::SequenceSpan> {
+
+        std::vector<racon::SequenceSpan> dst;
+        for (const auto& it: src) {
+            dst.push_back({it->name().c_str(), static_cast<uint32_t>(it->name().size()),
+                it->data().c_str(), static_cast<uint32_t>(it->data().size()),
+                it->quality().c_str(), static_cast<uint32_t>(it->quality().size())});
+        }
+        return dst;
+    };
+    auto sequences_spans = to_spans(sequences);
+    auto targets_spans = to_spans(targets);
+
+    std::vector<std::string> lines;
+    gzFile file = gzopen((racon_test_data_path + "sample_overlaps.paf.gz").c_str(), "r");
+    ASSERT_NE(file, nullptr);
+    char buffer[4096];
+    while (gzgets(file, buffer, sizeof(buffer)) != nullptr) {
+        lines.emplace_back(buffer);
+    }
+    gzclose(file);
+
+    std::vector<racon::OverlapSpan> overlaps_spans;
+    for (const auto& it: lines) {
+        const char* q_name = it.c_str();
+        uint32_t q_name_length = strcspn(q_name, "\t");
+        char* end = nullptr;
+        uint32_t q_length = strtoul(q_name + q_name_length, &end, 10);
+        uint32_t q_begin = strtoul(end, &end, 10);
+        uint32_t q_end = strtoul(end, &end, 10);
+        char orientation = end[1];
+        const char* t_name = end + 3;
+        uint32_t t_name_length = strcspn(t_name, "\t");
+        uint32_t t_length = strtoul(t_name + t_name_length, &end, 10);
+        uint32_t t_begin = strtoul(end, &end, 10);
+        uint32_t t_end = strtoul(end, &end, 10);
+        uint32_t matching_bases = strtoul(end, &end, 10);
+        uint32_t overlap_length = strtoul(end, &end, 10);
+        uint32_t mapping_quality = strtoul(end, &end, 10);
+
+        overlaps_spans.push_back({q_name, q_name_length, q_length, q_begin, q_end,
+            orientation, t_name, t_name_length, t_length, t_begin, t_end,
+            matching_bases, overlap_length, mapping_quality});
+    }
+
+    auto polisher = racon::createPolisher(sequences_spans.data(),
+        sequences_spans.size(), overlaps_spans.data(), overlaps_spans.size(),
+        targets_spans.data(), targets_spans.size(), racon::PolisherType::kC,
+        500, 10, 0.3, true, 5, -4, -8, 4);
+
+    std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+    polisher->run([&](std::unique_ptr<racon::Sequence> sequence) -> void {
+        polished_sequences.emplace_back(std::move(sequence));
+    }, true);
+    EXPECT_EQ(polished_sequences.size(), 1);
+
+    polished_sequences[0]->create_reverse_complement();
+
+    auto parser = bioparser::createParser<bioparser::FastaParser, racon::Sequence>(
+        racon_test_data_path + "sample_reference.fasta.gz");
+    parser->parse(polished_sequences, -1);
+    EXPECT_EQ(polished_sequences.size(), 2);
+
+    EXPECT_EQ(calculateEditDistance(polished_sequences[0]->reverse_complement(),
+        polished_sequences[1]->data()), kEditDistance);
+}
+
+TEST_F(RaconPolishingTest, ConsensusWithQualitiesShards) {
+    std::vector<std::unique_ptr<racon::Sequence>> polished_sequences;
+    for (uint32_t i = 0; i < 2; ++i) {
+        SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +
+            "sample_overlaps.paf.gz", racon_test_data_path + "sample_layout.fasta.gz",
+            racon::PolisherType::kC, 500, 10, 0.3, 5, -4, -8, 0, false, 0, "", "",
+            i, 2);
+
+        initialize();
+        polish(polished_sequences, true);
+        EXPECT_EQ(polished_sequences.size(), 1);
+
+        polisher.reset();
+    }
+
+    polished_sequences[0]->create_reverse_complement();
+
+    auto parser = bioparser::createParser<bioparser::FastaParser, racon::Sequence>(
+        racon_test_data_path + "sample_reference.fasta.gz");
+    parser->parse(polished_sequences, -1);
+    EXPECT_EQ(polished_sequences.size(), 2);
+
+    EXPECT_EQ(calculateEditDistance(polished_sequences[0]->reverse_complement(),
+        polished_sequences[1]->data()), kEditDistance);
+}
+
+TEST(RaconWriterTest, CompressedWithIndex) {
+    char directory[] = "/tmp/racon_writer_XXXXXX";
+    ASSERT_TRUE(mkdtemp(directory) != nullptr);
+    std::string path = std::string(directory) + "/polished.fasta.gz";
+
+    // the second sequence spans several blocks
+    std::vector<std::unique_ptr<racon::Sequence>> sequences;
+    sequences.emplace_back(racon::createSequence("a LN:i:4", "ACGT"));
+    sequences.emplace_back(racon::createSequence("b", std::string(200000, 'G')));
+
+    auto writer = racon::createWriter(path, true, 4);
+    for (const auto& it: sequences) {
+        writer->write(*it);
+    }
+    writer->close();
+
+    std::vector<std::unique_ptr<racon::Sequence>> written;
+    auto parser = bioparser::createParser<bioparser::FastaParser, racon::Sequence>(path);
+    parser->parse(written, -1);
+    ASSERT_EQ(written.size(), 2);
+    EXPECT_EQ(written[0]->data(), sequences[0]->data());
+    EXPECT_EQ(written[1]->data(), sequences[1]->data());
+
+    char buffer[256] = {0};
+    FILE* fai = fopen((path + ".fai").c_str(), "r");
+    ASSERT_NE(fai, nullptr);
+    EXPECT_EQ(fread(buffer, 1, sizeof(buffer) - 1, fai), 37);
+    fclose(fai);
+    EXPECT_STREQ(buffer, "a\t4\t10\t4\t5\nb\t200000\t18\t200000\t200001\n");
+
+    FILE* gzi = fopen((path + ".gzi").c_str(), "rb");
+    ASSERT_NE(gzi, nullptr);
+    uint64_t num_entries = 0;
+    EXPECT_EQ(fread(&num_entries, sizeof(num_entries), 1, gzi), 1);
+    fclose(gzi);
+    EXPECT_EQ(num_entries, 3);
+
+    EXPECT_EQ(remove((path + ".gzi").c_str()), 0);
+    EXPECT_EQ(remove((path + ".fai").c_str()), 0);
+    EXPECT_EQ(remove(path.c_str()), 0);
+    EXPECT_EQ(remove(directory), 0);
+}
+
+TEST(RaconNumaTest, FakeTopology) {
+    char directory[] = "/tmp/racon_numa_XXXXXX";
+    ASSERT_TRUE(mkdtemp(directory) != nullptr);
+
+    // nodes are sorted by their identifiers, entries without CPUs are skipped
+    std::vector<std::pair<std::string, std::string>> cpulists = {
+        {"node1", "4-5,7\n"}, {"node0", "0-3\n"}, {"node2", "\n"}};
+    for (const auto& it: cpulists) {
+        std::string node = std::string(directory) + "/" + it.first;
+        ASSERT_EQ(mkdir(node.c_str(), 0700), 0);
+        FILE* file = fopen((node + "/cpulist").c_str(), "w");
+        ASSERT_NE(file, nullptr);
+        fputs(it.second.c_str(), file);
+        fclose(file);
+    }
+
+    auto nodes = racon::numaNodes(directory);
+    ASSERT_EQ(nodes.size(), 2);
+    EXPECT_EQ(nodes[0], std::vector<uint32_t>({0, 1, 2, 3}));
+    EXPECT_EQ(nodes[1], std::vector<uint32_t>({4, 5, 7}));
+    EXPECT_TRUE(racon::numaNodes(std::string(directory) + "/none").empty());
+
+    for (const auto& it: cpulists) {
+        std::string node = std::string(directory) + "/" + it.first;
+        EXPECT_EQ(remove((node + "/cpulist").c_str()), 0);
+        EXPECT_EQ(rmdir(node.c_str()), 0);
+    }
+    EXPECT_EQ(rmdir(directory), 0);
+
+    EXPECT_EQ(racon::assignWorkers(5, nodes.size()),
+        std::vector<uint32_t>({0, 0, 0, 1, 1}));
+    EXPECT_EQ(racon::assignWorkers(2, 3), std::vector<uint32_t>({0, 1}));
+
+    // runs of windows of one target stay on one node
+    auto runs = racon::assignRuns({0, 0, 0, 1, 2, 2, 3}, nodes.size());
+    ASSERT_EQ(runs.size(), 2);
+    EXPECT_EQ(runs[0], std::vector<uint64_t>({0, 1, 2, 6}));
+    EXPECT_EQ(runs[1], std::vector<uint64_t>({3, 4, 5}));
+}
+
 #ifdef CUDA_ENABLED
 TEST_F(RaconPolishingTest, ConsensusWithQualitiesCUDA) {
     SetUp(racon_test_data_path + "sample_reads.fastq.gz", racon_test_data_path +